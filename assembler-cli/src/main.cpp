@@ -0,0 +1,130 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "assembler.h"
+#include "program.h"
+#include "util.h"
+
+constexpr size_t MAX_SOURCE_SIZE = 65536;
+
+typedef struct {
+    const char* image_path;
+    const char* source_path;
+} options;
+
+static void usage(const char* const name) {
+    fprintf(stderr,
+            "Usage: %s [-o image] source\n"
+            "\n"
+            "  -o image  Write the raw %d byte RAM image, as taken by the\n"
+            "            simulator and programmer-cli. Without it, the image\n"
+            "            is printed in hex.\n",
+            name, MEMORY_SIZE);
+}
+
+static int parse_options(options* const opts, const int argc,
+                         char* const argv[]) {
+    *opts = {
+        .image_path  = nullptr,
+        .source_path = nullptr,
+    };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "o:")) != -1) {
+        switch (opt) {
+            case 'o':
+                opts->image_path = optarg;
+                break;
+            default:
+                return -1;
+        }
+    }
+
+    if (optind + 1 != argc) {
+        return -1;
+    }
+    opts->source_path = argv[optind];
+
+    return 0;
+}
+
+// NUL-terminates the source.
+static int read_source(char source[MAX_SOURCE_SIZE + 1],
+                       const char* const path) {
+    FILE* const file = fopen(path, "r");
+    if (file == nullptr) {
+        perror(path);
+        return -1;
+    }
+
+    const size_t size    = fread(source, 1, MAX_SOURCE_SIZE, file);
+    const bool too_large = fgetc(file) != EOF;
+    (void)fclose(file);
+
+    if (too_large) {
+        fprintf(stderr, "%s: longer than %zu bytes\n", path, MAX_SOURCE_SIZE);
+        return -1;
+    }
+    source[size] = '\0';
+
+    return 0;
+}
+
+static int write_image(const uint8_t* const image, const char* const path) {
+    FILE* const file = fopen(path, "wb");
+    if (file == nullptr) {
+        perror(path);
+        return -1;
+    }
+
+    const size_t size = fwrite(image, 1, MEMORY_SIZE, file);
+    if (fclose(file) != 0 || size != MEMORY_SIZE) {
+        perror(path);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void print_image(const uint8_t* const image) {
+    for (uint16_t address = 0; address < MEMORY_SIZE;
+         address += HEX_FMT_ELEMENT_COUNT) {
+        char line[HEX_FMT_BUFFER_SIZE];
+        (void)format_data_as_hex(line, &image[address], address,
+                                 HEX_FMT_ELEMENT_COUNT);
+        printf("%s\n", line);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    options opts;
+    if (parse_options(&opts, argc, argv) != 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    static char source[MAX_SOURCE_SIZE + 1];
+    if (read_source(source, opts.source_path) != 0) {
+        return EXIT_FAILURE;
+    }
+
+    // The same assembler that builds the bootloader's program at compile
+    // time, run on the file instead.
+    const assembler_result<MEMORY_SIZE> result =
+        assemble<MEMORY_SIZE>(source);
+    if (result.error != ASSEMBLER_OK) {
+        fprintf(stderr, "%s:%u: %s\n", opts.source_path, result.line,
+                assembler_error_messages[result.error]);
+        return EXIT_FAILURE;
+    }
+
+    if (opts.image_path == nullptr) {
+        print_image(result.image);
+        return EXIT_SUCCESS;
+    }
+
+    return write_image(result.image, opts.image_path) == 0 ? EXIT_SUCCESS
+                                                            : EXIT_FAILURE;
+}
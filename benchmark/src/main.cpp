@@ -0,0 +1,426 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dump.h"
+#include "pin-map.h"
+#include "util.h"
+
+constexpr uint32_t ITERATION_COUNT = 10000000;
+
+typedef struct {
+    const char* name;
+    int (*run)(void);
+} benchmark;
+
+// Wiring of the EEPROM programmer's data bus.
+static constexpr uint8_t data_pins[] = {14, 15, 16, 17, 4, 5, 6, 7};
+using data_bus = pin_map_bus<14, 15, 16, 17, 4, 5, 6, 7>;
+
+static_assert(data_bus::matches(data_pins), "Bus doesn't match the pins.");
+
+enum {
+    INPUT,
+    OUTPUT,
+};
+
+// Stand-in for SREG.
+static volatile uint8_t interrupt_state;
+
+// Same work as the Arduino core per call: a table lookup of the pin's port
+// and bit, then a read-modify-write with interrupts disabled.
+// (wiring_digital.c, ArduinoCore-avr)
+__attribute__((noinline)) static void arduino_pin_mode(const uint8_t pin,
+                                                       const uint8_t mode) {
+    const pin_map_location location = pin_map_locate(pin);
+    const uint8_t mask              = BIT(location.bit);
+
+    const uint8_t state = interrupt_state;
+    interrupt_state     = 0;
+
+    const uint8_t ddr = pin_map_read(location.port, PIN_MAP_DDR);
+    if (mode == OUTPUT) {
+        pin_map_write(location.port, PIN_MAP_DDR, ddr | mask);
+    } else {
+        pin_map_write(location.port, PIN_MAP_DDR, ddr & ~mask);
+
+        // Plain inputs have their pull-up disabled.
+        const uint8_t port = pin_map_read(location.port, PIN_MAP_PORT);
+        pin_map_write(location.port, PIN_MAP_PORT, port & ~mask);
+    }
+
+    interrupt_state = state;
+}
+
+__attribute__((noinline)) static void arduino_digital_write(const uint8_t pin,
+                                                            const bool level) {
+    const pin_map_location location = pin_map_locate(pin);
+    const uint8_t mask              = BIT(location.bit);
+
+    const uint8_t state = interrupt_state;
+    interrupt_state     = 0;
+
+    const uint8_t port = pin_map_read(location.port, PIN_MAP_PORT);
+    pin_map_write(location.port, PIN_MAP_PORT,
+                  level ? port | mask : port & ~mask);
+
+    interrupt_state = state;
+}
+
+__attribute__((noinline)) static bool arduino_digital_read(const uint8_t pin) {
+    const pin_map_location location = pin_map_locate(pin);
+
+    return (pin_map_read(location.port, PIN_MAP_PIN) & BIT(location.bit)) != 0;
+}
+
+// eeprom_write()'s data bus traffic, with and without pin-map.
+static void arduino_write(const uint8_t data) {
+    for (unsigned short i = 0; i < ARRAY_SIZE(data_pins); ++i) {
+        arduino_pin_mode(data_pins[i], OUTPUT);
+    }
+    for (unsigned short i = 0; i < ARRAY_SIZE(data_pins); ++i) {
+        arduino_digital_write(data_pins[i], (data & BIT(i)) != 0);
+    }
+    for (unsigned short i = 0; i < ARRAY_SIZE(data_pins); ++i) {
+        arduino_pin_mode(data_pins[i], INPUT);
+    }
+}
+
+static void pin_map_write_byte(const uint8_t data) {
+    data_bus::set_output(true);
+    data_bus::write(data);
+
+    // Back to plain inputs, as set_data_bus_mode(INPUT) does.
+    data_bus::write(0);
+    data_bus::set_output(false);
+}
+
+static uint8_t arduino_read(void) {
+    uint8_t data = 0;
+    for (unsigned short i = 0; i < ARRAY_SIZE(data_pins); ++i) {
+        data |= arduino_digital_read(data_pins[i]) << i;
+    }
+
+    return data;
+}
+
+static uint8_t pin_map_read_byte(void) {
+    return data_bus::read();
+}
+
+typedef struct {
+    uint8_t registers[PIN_MAP_PORT_COUNT][PIN_MAP_REGISTER_COUNT];
+} register_snapshot;
+
+static register_snapshot snapshot(void) {
+    register_snapshot registers;
+    for (unsigned short port = 0; port < PIN_MAP_PORT_COUNT; ++port) {
+        for (unsigned short reg = PIN_MAP_DDR; reg < PIN_MAP_REGISTER_COUNT;
+             ++reg) {
+            registers.registers[port][reg] =
+                pin_map_read((pin_map_port)port, (pin_map_register)reg);
+        }
+    }
+
+    return registers;
+}
+
+static bool same_registers(const register_snapshot* const a,
+                           const register_snapshot* const b) {
+    for (unsigned short port = 0; port < PIN_MAP_PORT_COUNT; ++port) {
+        for (unsigned short reg = PIN_MAP_DDR; reg < PIN_MAP_REGISTER_COUNT;
+             ++reg) {
+            if (a->registers[port][reg] != b->registers[port][reg]) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Both paths have to leave the same register state behind and read the same
+// value, or the timings mean nothing.
+static int check_data_bus(void) {
+    for (unsigned short value = 0; value <= MASK(7, 0); ++value) {
+        pin_map_mock_reset();
+        for (unsigned short i = 0; i < ARRAY_SIZE(data_pins); ++i) {
+            arduino_pin_mode(data_pins[i], OUTPUT);
+            arduino_digital_write(data_pins[i], (value & BIT(i)) != 0);
+        }
+        const register_snapshot arduino = snapshot();
+        const uint8_t arduino_value     = arduino_read();
+
+        pin_map_mock_reset();
+        data_bus::set_output(true);
+        data_bus::write(value);
+        const register_snapshot pin_map = snapshot();
+        const uint8_t pin_map_value     = pin_map_read_byte();
+
+        if (!same_registers(&arduino, &pin_map) || arduino_value != value ||
+            pin_map_value != value) {
+            fprintf(stderr, "data bus: mismatch writing %02x\n", value);
+            return -1;
+        }
+
+        // Reading what the EEPROM drives.
+        pin_map_mock_reset();
+        for (unsigned short port = 0; port < PIN_MAP_PORT_COUNT; ++port) {
+            pin_map_mock_drive((pin_map_port)port, MASK(7, 0),
+                               value * (port + 1));
+        }
+        if (arduino_read() != pin_map_read_byte()) {
+            fprintf(stderr, "data bus: mismatch reading %02x\n", value);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static double now(void) {
+    struct timespec ts;
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Time per call in ns.
+template <typename function>
+static double measure(const function& body) {
+    const double start = now();
+    for (uint32_t i = 0; i < ITERATION_COUNT; ++i) {
+        body(i);
+    }
+
+    return (now() - start) / ITERATION_COUNT * 1e9;
+}
+
+static void report(const char* const name, const double baseline,
+                   const double optimized) {
+    printf("%-16s %7.1f ns  ->  %6.1f ns  (%.1fx)\n", name, baseline,
+           optimized, baseline / optimized);
+}
+
+static int benchmark_data_bus(void) {
+    if (check_data_bus() != 0) {
+        return -1;
+    }
+
+    volatile uint8_t sink = 0;
+
+    pin_map_mock_reset();
+    const double arduino_write_time =
+        measure([](const uint32_t i) { arduino_write(i); });
+    const double pin_map_write_time =
+        measure([](const uint32_t i) { pin_map_write_byte(i); });
+
+    pin_map_mock_reset();
+    pin_map_mock_drive(PIN_MAP_PORT_C, MASK(7, 0), 0x5a);
+    pin_map_mock_drive(PIN_MAP_PORT_D, MASK(7, 0), 0xa5);
+    const double arduino_read_time =
+        measure([&](const uint32_t) { sink = sink + arduino_read(); });
+    const double pin_map_read_time =
+        measure([&](const uint32_t) { sink = sink + pin_map_read_byte(); });
+
+    printf("Data bus, Arduino calls -> pin-map (mock registers):\n");
+    report("byte write", arduino_write_time, pin_map_write_time);
+    report("byte read", arduino_read_time, pin_map_read_time);
+
+    return 0;
+}
+
+// The sprintf() based formatter that util used to have, for comparison. Each
+// call rescans the line so far, and the source and destination overlap.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wrestrict"
+static void legacy_format_data_as_hex(char* const buffer,
+                                      const uint8_t* const data,
+                                      const uint16_t address,
+                                      const uint8_t size) {
+    (void)sprintf(buffer, "%03x: ", address & ~(HEX_FMT_ELEMENT_COUNT - 1));
+
+    const unsigned short skipped = address % HEX_FMT_ELEMENT_COUNT;
+    for (unsigned short i = 0; i < skipped + size; ++i) {
+        if (i < skipped) {
+            (void)sprintf(buffer, "%s   ", buffer);
+        } else {
+            (void)sprintf(buffer, "%s %02x", buffer, data[i - skipped]);
+        }
+
+        if (i % 8 == 7) {
+            (void)sprintf(buffer, "%s ", buffer);
+        }
+    }
+}
+#pragma GCC diagnostic pop
+
+static int benchmark_hex_format(void) {
+    uint8_t data[HEX_FMT_ELEMENT_COUNT];
+    for (unsigned short i = 0; i < ARRAY_SIZE(data); ++i) {
+        data[i] = i * 37;
+    }
+
+    char legacy[HEX_FMT_BUFFER_SIZE];
+    char current[HEX_FMT_BUFFER_SIZE];
+    legacy_format_data_as_hex(legacy, data, 0x120, ARRAY_SIZE(data));
+    (void)format_data_as_hex(current, data, 0x120, ARRAY_SIZE(data));
+    if (strcmp(legacy, current) != 0) {
+        fprintf(stderr, "hex format: \"%s\" != \"%s\"\n", legacy, current);
+        return -1;
+    }
+
+    volatile char sink = 0;
+
+    const double legacy_time = measure([&](const uint32_t i) {
+        legacy_format_data_as_hex(legacy, data, i, ARRAY_SIZE(data));
+        sink = sink + legacy[5];
+    });
+    const double hex_time = measure([&](const uint32_t i) {
+        (void)format_data_as_hex(current, data, i, ARRAY_SIZE(data));
+        sink = sink + current[5];
+    });
+    const double intel_hex_time = measure([&](const uint32_t i) {
+        char buffer[INTEL_HEX_FMT_BUFFER_SIZE];
+        (void)format_data_as_intel_hex(buffer, data, i, ARRAY_SIZE(data));
+        sink = sink + buffer[5];
+    });
+
+    printf("Dump line of %d bytes, sprintf -> nibble table:\n",
+           HEX_FMT_ELEMENT_COUNT);
+    report("hex", legacy_time, hex_time);
+    report("intel hex", legacy_time, intel_hex_time);
+
+    return 0;
+}
+
+// The dump runs against a simulated clock: EEPROM reads take a fixed time per
+// byte and the UART sends one byte per frame time from a TX buffer the size of
+// HardwareSerial's.
+constexpr uint64_t UART_BYTE_NS       = 10 * 1000000000ull / 115200;
+constexpr uint8_t UART_TX_BUFFER_SIZE = 64;
+constexpr uint16_t DUMP_SIZE          = 1024;
+
+typedef struct {
+    uint64_t now_ns;
+    uint64_t read_ns_per_byte;
+
+    // Whether each write waits for the TX buffer to empty, as if the UART
+    // weren't interrupt driven.
+    bool flush_writes;
+
+    uint8_t tx_queued;
+    uint64_t tx_next_done_ns;  // When the byte in front is out.
+    uint32_t tx_bytes;
+} dump_simulation;
+
+static dump_simulation simulation;
+
+static void uart_wait_for_byte(void) {
+    simulation.now_ns = simulation.tx_next_done_ns;
+    --simulation.tx_queued;
+    simulation.tx_next_done_ns += UART_BYTE_NS;
+}
+
+static void uart_update(void) {
+    while (simulation.tx_queued > 0 &&
+           simulation.tx_next_done_ns <= simulation.now_ns) {
+        uart_wait_for_byte();
+    }
+}
+
+static void simulated_read(uint8_t* const buffer, const uint16_t address,
+                           const uint16_t size) {
+    for (uint16_t i = 0; i < size; ++i) {
+        buffer[i] = (address + i) * 37;
+    }
+    simulation.now_ns += size * simulation.read_ns_per_byte;
+}
+
+// HardwareSerial::write(): spins while the TX buffer is full.
+static void simulated_write(const uint8_t* const, const uint16_t size) {
+    for (uint16_t i = 0; i < size; ++i) {
+        uart_update();
+        if (simulation.tx_queued == UART_TX_BUFFER_SIZE) {
+            uart_wait_for_byte();
+        }
+
+        if (simulation.tx_queued == 0) {
+            simulation.tx_next_done_ns = simulation.now_ns + UART_BYTE_NS;
+        }
+        ++simulation.tx_queued;
+        ++simulation.tx_bytes;
+    }
+
+    while (simulation.flush_writes && simulation.tx_queued > 0) {
+        uart_wait_for_byte();
+    }
+}
+
+static const dump_config simulated_dump = {
+    .read  = simulated_read,
+    .write = simulated_write,
+};
+
+// Time until the last byte is out, in ms.
+static double simulate_dump(const uint64_t read_ns_per_byte,
+                            const bool flush_writes) {
+    simulation                  = {};
+    simulation.read_ns_per_byte = read_ns_per_byte;
+    simulation.flush_writes     = flush_writes;
+
+    dump(&simulated_dump, 0, DUMP_SIZE, DUMP_FORMAT_HEX);
+    while (simulation.tx_queued > 0) {
+        uart_wait_for_byte();
+    }
+
+    return simulation.now_ns / 1e6;
+}
+
+static int benchmark_dump(void) {
+    // Reading a byte costs two shiftOut() calls with the Arduino core, and
+    // about a tenth of that with the address shifted out by port writes.
+    static const uint64_t read_costs_ns[] = {200000, 20000};
+
+    printf("Hex dump of %d bytes at 115200 baud, flushing each line -> "
+           "buffered (simulated clock):\n",
+           DUMP_SIZE);
+    for (unsigned short i = 0; i < ARRAY_SIZE(read_costs_ns); ++i) {
+        const double flushed  = simulate_dump(read_costs_ns[i], true);
+        const double buffered = simulate_dump(read_costs_ns[i], false);
+
+        // The UART has to send this much either way.
+        const double serial_bound = simulation.tx_bytes * UART_BYTE_NS / 1e6;
+
+        printf("%3llu us/byte read %7.1f ms  ->  %6.1f ms  (%.1fx, serial "
+               "bound %.1f ms)\n",
+               (unsigned long long)read_costs_ns[i] / 1000, flushed, buffered,
+               flushed / buffered, serial_bound);
+    }
+
+    return 0;
+}
+
+static const benchmark benchmarks[] = {
+    {"data-bus",   benchmark_data_bus  },
+    {"hex-format", benchmark_hex_format},
+    {"dump",       benchmark_dump      },
+};
+
+// Runs the benchmarks named on the command line, or all of them.
+int main(int argc, char* argv[]) {
+    for (unsigned short i = 0; i < ARRAY_SIZE(benchmarks); ++i) {
+        bool selected = argc == 1;
+        for (int arg = 1; arg < argc; ++arg) {
+            selected = selected || strcmp(argv[arg], benchmarks[i].name) == 0;
+        }
+
+        if (selected && benchmarks[i].run() != 0) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
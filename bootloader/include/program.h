@@ -1,20 +1,12 @@
 #ifndef PROGRAM_H
 #define PROGRAM_H
 
-#ifdef __cplusplus
-extern "C" {
-#endif  // __cplusplus
-
 #include <stdint.h>
 
 #define MEMORY_SIZE 16
 
-// C++ doesn't allow designated initializers for arrays, so we keep the program
-// in C space.
-extern const uint8_t program[MEMORY_SIZE];
-
-#ifdef __cplusplus
-}
-#endif  // __cplusplus
+// Assembled at compile time and kept in flash. Read it with pgm_read_byte()
+// or memcpy_P().
+extern const uint8_t (&program)[MEMORY_SIZE];
 
 #endif  // PROGRAM_H
@@ -1,8 +1,12 @@
 #include <Arduino.h>
 #include <pins_arduino.h>
+#include <stdbool.h>
 #include <stdint.h>
 
+#include "pin-map.h"
 #include "program.h"
+#include "programmer-protocol.h"
+#include "programmer-server.h"
 #include "util.h"
 
 constexpr uint8_t BUS_PINS[8] = {9, 10, 11, 12, A0, A1, A2, A3};
@@ -19,6 +23,22 @@ constexpr uint8_t RAM_OUT = 21;
 
 constexpr uint8_t SIGNED = 13;
 
+// Frames from programmer-cli come in on the monitor port. 115200 baud is off
+// by 8.5% on the 8 MHz internal oscillator, 38400 by 0.2%.
+// (Section 20.10, ATmega328P Datasheet)
+constexpr unsigned long BAUD_RATE = 38400;
+
+// Read the program back through RAM_OUT after loading it.
+constexpr bool VERIFY_PROGRAM = true;
+
+using bus       = pin_map_bus<9, 10, 11, 12, A0, A1, A2, A3>;
+using memory_in = pin_map_pin<MEMORY_IN>;
+using ram_in    = pin_map_pin<RAM_IN>;
+using ram_out   = pin_map_pin<RAM_OUT>;
+using clock_pin = pin_map_pin<CLOCK>;
+
+static_assert(bus::matches(BUS_PINS), "Bus doesn't match BUS_PINS.");
+
 constexpr uint8_t control_signals[] = {
     MEMORY_IN, RAM_IN, RAM_OUT, RESET, HALT,
 };
@@ -30,59 +50,170 @@ static void pulse_pin(const uint8_t pin) {
     digitalWrite(pin, LOW);
 }
 
-static void write_to_bus(const uint8_t byte) {
-    for (uint8_t i = 0; i < ARRAY_SIZE(BUS_PINS); ++i) {
-        digitalWrite(BUS_PINS[i], (byte & BIT(i)) != 0);
-    }
+// The clock stays high for two CPU cycles, 250 ns at 8 MHz, which is well
+// above the minimum clock width of the computer's 74LS registers.
+static inline void pulse_clock(void) {
+    clock_pin::write(HIGH);
+    clock_pin::write(LOW);
 }
 
-static void write_to_ram(const uint8_t address, const uint8_t byte) {
-    write_to_bus(address);
-    digitalWrite(MEMORY_IN, HIGH);
-    pulse_pin(CLOCK);
-    digitalWrite(MEMORY_IN, LOW);
-
-    write_to_bus(byte);
-    digitalWrite(RAM_IN, HIGH);
-    pulse_pin(CLOCK);
-    digitalWrite(RAM_IN, LOW);
+template <typename control>
+static inline void clock_in(const uint8_t byte) {
+    bus::write(byte);
+    control::write(HIGH);
+    pulse_clock();
+    control::write(LOW);
 }
 
-static void write_program(void) {
+// Halts the computer and drives its bus in place of the microcode. The clock
+// and the EEPROM are stopped before any of our lines turn into outputs, so the
+// Nano never drives the bus against them.
+static void take_bus(void) {
     digitalWrite(HALT, HIGH);       // Halt system clock.
     digitalWrite(EEPROM_CE, HIGH);  // Disable EEPROM.
+    pinMode(HALT, OUTPUT);
 
-    for (uint8_t i = 0; i < ARRAY_SIZE(program); ++i) {
-        write_to_ram(i, program[i]);
+    bus::set_output(true);
+    for (uint8_t i = 0; i < ARRAY_SIZE(control_signals); ++i) {
+        pinMode(control_signals[i], OUTPUT);
     }
+}
+
+// Restarts the computer on what is in RAM. The bus is released before the
+// EEPROM is enabled again.
+static void release_bus(void) {
+    bus::write(0);
+    bus::set_output(false);
 
     digitalWrite(EEPROM_CE, LOW);  // Enable EEPROM.
+    digitalWrite(SIGNED, LOW);     // Disable signed mode.
+    pulse_pin(RESET);              // Reset the computer.
+
+    // Deassert the control lines.
+    for (uint8_t i = 0; i < ARRAY_SIZE(control_signals); ++i) {
+        pinMode(control_signals[i], INPUT);
+    }
 }
 
-void setup(void) {
-    // Assert the pins.
-    for (uint8_t i = 0; i < ARRAY_SIZE(BUS_PINS); ++i) {
-        pinMode(BUS_PINS[i], OUTPUT);
+static void load(const uint16_t address, const uint8_t* const data,
+                 const uint8_t size) {
+    for (uint8_t i = 0; i < size; ++i) {
+        clock_in<memory_in>(address + i);
+        clock_in<ram_in>(data[i]);
     }
-    for (uint8_t i = 0; i < ARRAY_SIZE(control_signals); ++i) {
-        pinMode(control_signals[i], OUTPUT);
+}
+
+static void read(uint8_t* const buffer, const uint16_t address,
+                 const uint8_t size) {
+    for (uint8_t i = 0; i < size; ++i) {
+        clock_in<memory_in>(address + i);
+
+        // Released before the RAM drives it, without pull-ups.
+        bus::write(0);
+        bus::set_output(false);
+        ram_out::write(HIGH);
+
+        // Lets the RAM's output settle and the pin synchronizer catch up.
+        delayMicroseconds(1);
+        buffer[i] = bus::read();
+
+        ram_out::write(LOW);
+        bus::set_output(true);
     }
+}
+
+// Loads are complete as soon as the last byte is clocked in.
+static void wait(void) {}
+
+static void send(const uint8_t* const data, const uint8_t size) {
+    (void)Serial.write(data, size);
+}
+
+// A session halts the computer on BEGIN and restarts it on FINISH, so a
+// program can be swapped without reflashing the Nano.
+static const programmer_server_config config = {
+    .begin_write = load,
+    .wait        = wait,
+    .read        = read,
+    .send        = send,
+    .memory_size = MEMORY_SIZE,
+    .page_size   = MEMORY_SIZE,
+    .begin       = take_bus,
+    .finish      = release_bus,
+};
+
+static programmer_server server;
+
+// Prints the first address that doesn't hold what was loaded.
+static bool verify_program(const uint8_t* const image) {
+    uint8_t memory[MEMORY_SIZE];
+    read(memory, 0, ARRAY_SIZE(memory));
+
+    for (uint8_t address = 0; address < ARRAY_SIZE(memory); ++address) {
+        if (memory[address] != image[address]) {
+            Serial.print("Mismatch at ");
+            Serial.print(address);
+            Serial.print(": wrote ");
+            Serial.print(image[address], HEX);
+            Serial.print(", read ");
+            Serial.println(memory[address], HEX);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Loads the program built into the firmware.
+static void write_program(void) {
+    uint8_t image[MEMORY_SIZE];
+    memcpy_P(image, program, sizeof(image));
+
+    const unsigned long load_start = micros();
+    load(0, image, ARRAY_SIZE(image));
+    const unsigned long load_time = micros() - load_start;
+
+    Serial.print("Loaded ");
+    Serial.print(ARRAY_SIZE(image));
+    Serial.print(" bytes in ");
+    Serial.print(load_time);
+    Serial.println(" us");
+
+    if (VERIFY_PROGRAM) {
+        const unsigned long verify_start = micros();
+        const bool verified              = verify_program(image);
+        const unsigned long verify_time  = micros() - verify_start;
+
+        Serial.print(verified ? "Verified in " : "Verify failed after ");
+        Serial.print(verify_time);
+        Serial.println(" us");
+    }
+}
+
+void setup(void) {
+    Serial.begin(BAUD_RATE);
+
     for (uint8_t i = 0; i < ARRAY_SIZE(config_pins); ++i) {
         pinMode(config_pins[i], OUTPUT);
     }
-
     digitalWrite(CLOCK, LOW);  // Assert our clock.
+
+    take_bus();
     write_program();
-    digitalWrite(SIGNED, LOW);  // Disable signed mode.
-    pulse_pin(RESET);           // Reset the computer.
+    release_bus();
 
-    // Deassert the pins.
-    for (uint8_t i = 0; i < ARRAY_SIZE(BUS_PINS); ++i) {
-        pinMode(BUS_PINS[i], INPUT);
-    }
-    for (uint8_t i = 0; i < ARRAY_SIZE(control_signals); ++i) {
-        pinMode(control_signals[i], INPUT);
-    }
+    programmer_server_init(&server, &config);
 }
 
-void loop(void) {}
+// Stays resident, taking programs from programmer-cli.
+void loop(void) {
+    static unsigned long last_receive_ms;
+
+    if (Serial.available() > 0) {
+        programmer_server_receive(&server, Serial.read());
+        last_receive_ms = millis();
+    } else if (millis() - last_receive_ms >=
+               PROGRAMMER_PROTOCOL_IDLE_TIMEOUT_MS) {
+        programmer_server_idle(&server);
+    }
+}
@@ -0,0 +1,29 @@
+#include "program.h"
+
+#include <stdint.h>
+
+#include "assembler.h"
+#include "util.h"
+
+// Counts up to 255, then back down to 0, and again.
+static constexpr assembler_result<MEMORY_SIZE> assembled PROGMEM =
+    assemble<MEMORY_SIZE>(R"(
+            LDA x
+    up:     ADD step
+            JC  down
+            OUT
+            JMP up
+    down:   SUB step
+            OUT
+            JZ  up
+            JMP down
+
+            .org 14
+    step:   .byte 1
+    x:      .byte 1
+)");
+
+static_assert(assembler_check<assembled.error, assembled.line>::ok,
+              "Program doesn't assemble.");
+
+const uint8_t (&program)[MEMORY_SIZE] = assembled.image;
@@ -0,0 +1,62 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+// The parts of the Arduino core that the sketches and libraries use, for
+// native builds. Pins go through the pin-map mock registers and time is
+// virtual; see arduino-native.h.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "util.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif  // F_CPU
+
+#define HIGH 1
+#define LOW  0
+
+#define INPUT        0
+#define OUTPUT       1
+#define INPUT_PULLUP 2
+
+#define DEC 10
+#define HEX 16
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+
+typedef uint8_t byte;
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// Wrap around like on the AVR, where unsigned long has 32 bits.
+unsigned long millis(void);
+unsigned long micros(void);
+
+// Defined by the sketch.
+void setup(void);
+void loop(void);
+
+#ifdef __cplusplus
+}
+
+#include "HardwareSerial.h"
+#endif  // __cplusplus
+
+#endif  // ARDUINO_H
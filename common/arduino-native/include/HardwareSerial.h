@@ -0,0 +1,45 @@
+#ifndef HARDWARE_SERIAL_H
+#define HARDWARE_SERIAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Sends to stdout at the speed of the UART: writes fill a TX buffer as big as
+// the AVR core's, which drains at the baud rate on the virtual clock, and
+// block while it is full. Nothing is ever received.
+class HardwareSerial {
+   public:
+    void begin(const unsigned long baud);
+    void flush(void);
+
+    int available(void);
+    int read(void);
+    int availableForWrite(void);
+
+    size_t write(const uint8_t byte);
+    size_t write(const uint8_t* const data, const size_t size);
+
+    size_t print(const char* const text);
+    size_t print(const char c);
+    size_t print(const unsigned char number, const int base = 10);
+    size_t print(const int number, const int base = 10);
+    size_t print(const unsigned int number, const int base = 10);
+    size_t print(const long number, const int base = 10);
+    size_t print(const unsigned long number, const int base = 10);
+
+    size_t println(void);
+    size_t println(const char* const text);
+    size_t println(const char c);
+    size_t println(const unsigned char number, const int base = 10);
+    size_t println(const int number, const int base = 10);
+    size_t println(const unsigned int number, const int base = 10);
+    size_t println(const long number, const int base = 10);
+    size_t println(const unsigned long number, const int base = 10);
+
+   private:
+    size_t print_number(unsigned long number, int base);
+};
+
+extern HardwareSerial Serial;
+
+#endif  // HARDWARE_SERIAL_H
@@ -0,0 +1,38 @@
+#ifndef SPI_H
+#define SPI_H
+
+#include <stdint.h>
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0c
+
+class SPISettings {
+   public:
+    SPISettings(const uint32_t clock, const uint8_t bit_order,
+                const uint8_t data_mode)
+        : clock(clock), bit_order(bit_order), data_mode(data_mode) {}
+
+    uint32_t clock;
+    uint8_t bit_order;
+    uint8_t data_mode;
+};
+
+// Bytes go to the devices attached with arduino_native_attach(). Each transfer
+// takes as long as 8 SPI clocks at the speed of the current transaction.
+class SPIClass {
+   public:
+    void begin(void);
+    void end(void);
+    void beginTransaction(const SPISettings settings);
+    void endTransaction(void);
+    uint8_t transfer(const uint8_t data);
+};
+
+extern SPIClass SPI;
+
+#endif  // SPI_H
@@ -0,0 +1,58 @@
+#ifndef ARDUINO_NATIVE_H
+#define ARDUINO_NATIVE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pin-map.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+// Runs the Arduino API natively on a virtual clock. Nothing takes real time:
+// each call advances the clock by what it roughly costs on the Nano at
+// F_CPU, delays advance it by their length, and device models read it to
+// time what they do. Code in between calls is free, so run times come out a
+// little short of the real thing wherever the CPU rather than I/O or the
+// devices is the bottleneck.
+
+#define ARDUINO_NATIVE_MAX_DEVICES 4
+
+// A model of a chip on the board. The hooks are optional.
+typedef struct {
+    // Called with each byte shifted out by SPI.transfer().
+    void (*spi_transfer)(const uint8_t data, void* const context);
+
+    // As in pin_map_mock_hooks, for every device.
+    void (*before_read)(const pin_map_port port, void* const context);
+    void (*after_write)(const pin_map_port port, const pin_map_register reg,
+                        void* const context);
+
+    void* context;
+} arduino_native_device;
+
+// Resets the pins, detaches the devices and sets the clock back to 0.
+void arduino_native_reset(void);
+void arduino_native_attach(const arduino_native_device* const device);
+
+uint64_t arduino_native_now_ns(void);
+void arduino_native_advance_ns(const uint64_t ns);
+void arduino_native_advance_cycles(const uint32_t cycles);
+
+// The level the MCU puts on `pin`: its PORT bit when an output, high with the
+// pull-up on and `floating` otherwise.
+bool arduino_native_pin_output(const uint8_t pin, const bool floating);
+
+// For models that drive the MCU's input pins, from their before_read hook.
+// Pins float again on the next read unless driven again.
+void arduino_native_drive_pin(const uint8_t pin, const bool level);
+
+// Pins that two devices drove to different levels during a read.
+uint32_t arduino_native_bus_conflicts(void);
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+
+#endif  // ARDUINO_NATIVE_H
@@ -0,0 +1,375 @@
+#include "arduino-native.h"
+
+#include <Arduino.h>
+#include <HardwareSerial.h>
+#include <SPI.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "pin-map.h"
+#include "util.h"
+
+// Rough costs on the Nano. pinMode(), digitalWrite() and digitalRead() look
+// the pin up in flash tables and check for PWM first. A register access takes
+// an in or out, and a read-modify-write an sbi or cbi.
+constexpr uint32_t DIGITAL_IO_CYCLES     = 50;
+constexpr uint32_t REGISTER_READ_CYCLES  = 1;
+constexpr uint32_t REGISTER_WRITE_CYCLES = 2;
+constexpr uint32_t SPI_OVERHEAD_CYCLES   = 4;
+constexpr uint32_t SERIAL_WRITE_CYCLES   = 40;
+constexpr uint16_t SERIAL_TX_BUFFER_SIZE = 64;
+constexpr uint8_t SERIAL_BITS_PER_BYTE   = 10;  // With start and stop bits.
+constexpr uint64_t NS_PER_S              = 1000000000;
+constexpr uint64_t PS_PER_NS             = 1000;
+constexpr uint32_t SPI_MIN_CLOCK_DIVIDER = 2;
+constexpr uint32_t SPI_MAX_CLOCK_DIVIDER = 128;
+
+// In picoseconds, so that cycles of 62.5 ns add up exactly.
+static uint64_t now_ps;
+
+static const arduino_native_device* devices[ARDUINO_NATIVE_MAX_DEVICES];
+static uint8_t device_count;
+
+// Pins driven by the devices during the read of `reading_port`.
+static pin_map_port reading_port;
+static uint8_t driven_pins;
+static uint8_t driven_levels;
+static uint32_t bus_conflicts;
+
+// Devices drive the pins anew on each read. Whatever none of them drives
+// floats.
+static void before_read(const pin_map_port port, void* const context) {
+    (void)context;
+    arduino_native_advance_cycles(REGISTER_READ_CYCLES);
+
+    pin_map_mock_release(port, MASK(7, 0));
+    reading_port  = port;
+    driven_pins   = 0;
+    driven_levels = 0;
+
+    for (uint8_t i = 0; i < device_count; ++i) {
+        if (devices[i]->before_read != nullptr) {
+            devices[i]->before_read(port, devices[i]->context);
+        }
+    }
+}
+
+static void after_write(const pin_map_port port, const pin_map_register reg,
+                        void* const context) {
+    (void)context;
+    arduino_native_advance_cycles(REGISTER_WRITE_CYCLES);
+
+    for (uint8_t i = 0; i < device_count; ++i) {
+        if (devices[i]->after_write != nullptr) {
+            devices[i]->after_write(port, reg, devices[i]->context);
+        }
+    }
+}
+
+static const pin_map_mock_hooks hooks = {
+    .before_read = before_read,
+    .after_write = after_write,
+    .context     = nullptr,
+};
+
+void arduino_native_reset(void) {
+    pin_map_mock_reset();
+    pin_map_mock_set_hooks(&hooks);
+    device_count  = 0;
+    now_ps        = 0;
+    bus_conflicts = 0;
+}
+
+void arduino_native_attach(const arduino_native_device* const device) {
+    if (device_count < ARDUINO_NATIVE_MAX_DEVICES) {
+        devices[device_count++] = device;
+    }
+}
+
+uint64_t arduino_native_now_ns(void) {
+    return now_ps / PS_PER_NS;
+}
+
+void arduino_native_advance_ns(const uint64_t ns) {
+    now_ps += ns * PS_PER_NS;
+}
+
+void arduino_native_advance_cycles(const uint32_t cycles) {
+    now_ps += (uint64_t)cycles * NS_PER_S * PS_PER_NS / F_CPU;
+}
+
+bool arduino_native_pin_output(const uint8_t pin, const bool floating) {
+    const pin_map_location location = pin_map_locate(pin);
+    const uint8_t mask              = BIT(location.bit);
+
+    const bool high =
+        (pin_map_mock_read(location.port, PIN_MAP_PORT) & mask) != 0;
+    if ((pin_map_mock_read(location.port, PIN_MAP_DDR) & mask) != 0) {
+        return high;
+    }
+
+    return high || floating;
+}
+
+void arduino_native_drive_pin(const uint8_t pin, const bool level) {
+    const pin_map_location location = pin_map_locate(pin);
+    const uint8_t mask              = BIT(location.bit);
+    const uint8_t levels            = level ? mask : 0;
+
+    if (location.port == reading_port) {
+        if ((driven_pins & mask) != 0 && (driven_levels & mask) != levels) {
+            ++bus_conflicts;
+        }
+        driven_pins |= mask;
+        driven_levels = (driven_levels & ~mask) | levels;
+    }
+
+    pin_map_mock_drive(location.port, mask, levels);
+}
+
+uint32_t arduino_native_bus_conflicts(void) {
+    return bus_conflicts;
+}
+
+static void write_bit(const uint8_t pin, const pin_map_register reg,
+                      const bool set) {
+    const pin_map_location location = pin_map_locate(pin);
+    const uint8_t value             = pin_map_read(location.port, reg);
+    const uint8_t mask              = BIT(location.bit);
+    pin_map_write(location.port, reg, set ? value | mask : value & ~mask);
+}
+
+void pinMode(const uint8_t pin, const uint8_t mode) {
+    arduino_native_advance_cycles(DIGITAL_IO_CYCLES);
+
+    // The pull-up follows PORT, which the core sets before DDR. (Section
+    // 13.2.3, ATmega328P Datasheet)
+    if (mode != OUTPUT) {
+        write_bit(pin, PIN_MAP_PORT, mode == INPUT_PULLUP);
+    }
+    write_bit(pin, PIN_MAP_DDR, mode == OUTPUT);
+}
+
+void digitalWrite(const uint8_t pin, const uint8_t value) {
+    arduino_native_advance_cycles(DIGITAL_IO_CYCLES);
+    write_bit(pin, PIN_MAP_PORT, value != LOW);
+}
+
+int digitalRead(const uint8_t pin) {
+    arduino_native_advance_cycles(DIGITAL_IO_CYCLES);
+
+    const pin_map_location location = pin_map_locate(pin);
+    const uint8_t value             = pin_map_read(location.port, PIN_MAP_PIN);
+
+    return (value & BIT(location.bit)) != 0 ? HIGH : LOW;
+}
+
+void delay(const unsigned long ms) {
+    arduino_native_advance_ns((uint64_t)ms * 1000000);
+}
+
+void delayMicroseconds(const unsigned int us) {
+    arduino_native_advance_ns((uint64_t)us * 1000);
+}
+
+unsigned long millis(void) {
+    return (uint32_t)(arduino_native_now_ns() / 1000000);
+}
+
+unsigned long micros(void) {
+    return (uint32_t)(arduino_native_now_ns() / 1000);
+}
+
+SPIClass SPI;
+
+static uint32_t spi_clock_divider = SPI_MIN_CLOCK_DIVIDER;
+
+void SPIClass::begin(void) {}
+
+void SPIClass::end(void) {}
+
+// The hardware divides F_CPU by a power of 2 no faster than the requested
+// clock. (Section 18.5.2, ATmega328P Datasheet)
+void SPIClass::beginTransaction(const SPISettings settings) {
+    spi_clock_divider = SPI_MIN_CLOCK_DIVIDER;
+    while (spi_clock_divider < SPI_MAX_CLOCK_DIVIDER &&
+           F_CPU / spi_clock_divider > settings.clock) {
+        spi_clock_divider *= 2;
+    }
+}
+
+void SPIClass::endTransaction(void) {}
+
+// MISO isn't wired to anything, so nothing is shifted in.
+uint8_t SPIClass::transfer(const uint8_t data) {
+    arduino_native_advance_cycles(8 * spi_clock_divider + SPI_OVERHEAD_CYCLES);
+
+    for (uint8_t i = 0; i < device_count; ++i) {
+        if (devices[i]->spi_transfer != nullptr) {
+            devices[i]->spi_transfer(data, devices[i]->context);
+        }
+    }
+
+    return 0;
+}
+
+HardwareSerial Serial;
+
+static uint64_t serial_byte_ns;
+
+// When the UART is done with everything written so far.
+static uint64_t serial_idle_ns;
+
+void HardwareSerial::begin(const unsigned long baud) {
+    serial_byte_ns = SERIAL_BITS_PER_BYTE * NS_PER_S / baud;
+    serial_idle_ns = arduino_native_now_ns();
+}
+
+// Advances the clock to `ns` unless it is already past it.
+static void wait_until(const uint64_t ns) {
+    const uint64_t now = arduino_native_now_ns();
+    if (ns > now) {
+        arduino_native_advance_ns(ns - now);
+    }
+}
+
+void HardwareSerial::flush(void) {
+    wait_until(serial_idle_ns);
+    (void)fflush(stdout);
+}
+
+int HardwareSerial::available(void) {
+    return 0;
+}
+
+int HardwareSerial::read(void) {
+    return -1;
+}
+
+int HardwareSerial::availableForWrite(void) {
+    const uint64_t now = arduino_native_now_ns();
+    if (serial_byte_ns == 0 || serial_idle_ns <= now) {
+        return SERIAL_TX_BUFFER_SIZE;
+    }
+
+    const uint64_t queued =
+        (serial_idle_ns - now + serial_byte_ns - 1) / serial_byte_ns;
+
+    return queued < SERIAL_TX_BUFFER_SIZE ? SERIAL_TX_BUFFER_SIZE - queued : 0;
+}
+
+size_t HardwareSerial::write(const uint8_t byte) {
+    arduino_native_advance_cycles(SERIAL_WRITE_CYCLES);
+
+    // Wait for the byte at the head of the buffer to go out.
+    const uint64_t backlog = SERIAL_TX_BUFFER_SIZE * serial_byte_ns;
+    if (serial_idle_ns > backlog) {
+        wait_until(serial_idle_ns - backlog);
+    }
+
+    const uint64_t now   = arduino_native_now_ns();
+    const uint64_t start = serial_idle_ns > now ? serial_idle_ns : now;
+    serial_idle_ns       = start + serial_byte_ns;
+
+    return fputc(byte, stdout) == EOF ? 0 : 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* const data, const size_t size) {
+    size_t written = 0;
+    for (size_t i = 0; i < size; ++i) {
+        written += write(data[i]);
+    }
+
+    return written;
+}
+
+size_t HardwareSerial::print(const char* const text) {
+    size_t written = 0;
+    for (const char* c = text; *c != '\0'; ++c) {
+        written += write(*c);
+    }
+
+    return written;
+}
+
+size_t HardwareSerial::print(const char c) {
+    return write(c);
+}
+
+size_t HardwareSerial::print(const unsigned char number, const int base) {
+    return print_number(number, base);
+}
+
+size_t HardwareSerial::print(const int number, const int base) {
+    return print((long)number, base);
+}
+
+size_t HardwareSerial::print(const unsigned int number, const int base) {
+    return print_number(number, base);
+}
+
+// Only decimal numbers are signed, the rest print the 32-bit pattern.
+size_t HardwareSerial::print(const long number, const int base) {
+    if (base == DEC && number < 0) {
+        return write('-') + print_number(-(unsigned long)number, base);
+    }
+
+    return print_number((uint32_t)number, base);
+}
+
+size_t HardwareSerial::print(const unsigned long number, const int base) {
+    return print_number(number, base);
+}
+
+size_t HardwareSerial::println(void) {
+    return print("\r\n");
+}
+
+size_t HardwareSerial::println(const char* const text) {
+    return print(text) + println();
+}
+
+size_t HardwareSerial::println(const char c) {
+    return print(c) + println();
+}
+
+size_t HardwareSerial::println(const unsigned char number, const int base) {
+    return print(number, base) + println();
+}
+
+size_t HardwareSerial::println(const int number, const int base) {
+    return print(number, base) + println();
+}
+
+size_t HardwareSerial::println(const unsigned int number, const int base) {
+    return print(number, base) + println();
+}
+
+size_t HardwareSerial::println(const long number, const int base) {
+    return print(number, base) + println();
+}
+
+size_t HardwareSerial::println(const unsigned long number, const int base) {
+    return print(number, base) + println();
+}
+
+size_t HardwareSerial::print_number(unsigned long number, int base) {
+    if (base < 2) {
+        base = DEC;
+    }
+
+    // Base 2 of an unsigned long at most, plus the NUL.
+    char digits[8 * sizeof(number) + 1];
+    char* digit = &digits[ARRAY_SIZE(digits) - 1];
+    *digit      = '\0';
+
+    do {
+        const uint8_t value = number % base;
+        *--digit            = value < 10 ? '0' + value : 'A' + value - 10;
+        number /= base;
+    } while (number != 0);
+
+    return print(digit);
+}
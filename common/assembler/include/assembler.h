@@ -0,0 +1,429 @@
+#ifndef ASSEMBLER_H
+#define ASSEMBLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "op-code.h"
+#include "util.h"
+
+// SAP assembly, one statement per line:
+//
+//   loop:   ADD step    ; Labels end with a colon, comments with the line.
+//           JC  0x5     ; Operands are numbers or labels.
+//           OUT         ; NOP, OUT and HLT take no operand.
+//           .org 14     ; Continues at address 14.
+//   step:   .byte 1, 2  ; Data.
+//
+// Numbers are decimal, or hex and binary with 0x and 0b. Mnemonics and
+// directives are case insensitive, labels aren't.
+//
+// assemble() is a constant expression. The firmware gets its image built at
+// compile time, with errors failing the build, and assembler-cli runs the same
+// code on source files.
+
+typedef enum {
+    ASSEMBLER_OK,
+    ASSEMBLER_SYNTAX_ERROR,
+    ASSEMBLER_UNKNOWN_MNEMONIC,
+    ASSEMBLER_UNKNOWN_DIRECTIVE,
+    ASSEMBLER_MISSING_OPERAND,
+    ASSEMBLER_UNEXPECTED_OPERAND,
+    ASSEMBLER_VALUE_TOO_WIDE,
+    ASSEMBLER_UNDEFINED_LABEL,
+    ASSEMBLER_DUPLICATE_LABEL,
+    ASSEMBLER_TOO_MANY_LABELS,
+    ASSEMBLER_OUT_OF_MEMORY,
+    ASSEMBLER_OVERLAP,
+
+    ASSEMBLER_ERROR_COUNT,
+} assembler_error;
+
+constexpr const char* assembler_error_messages[ASSEMBLER_ERROR_COUNT] = {
+    "ok",
+    "syntax error",
+    "unknown mnemonic",
+    "unknown directive",
+    "missing operand",
+    "unexpected operand",
+    "value too wide",
+    "undefined label",
+    "duplicate label",
+    "too many labels",
+    "doesn't fit in memory",
+    "overlaps earlier code or data",
+};
+
+// Indexed by op_code.
+constexpr const char* assembler_mnemonics[OP_CODE_COUNT] = {
+    "NOP", "LDA", "ADD", "SUB", "STA", "LDI", "ADI", "SBI",
+    "JMP", "JC",  "JZ",  "OUT", "HLT", "JNC", "JNZ", "ADO",
+};
+
+constexpr bool assembler_takes_operand(const op_code code) {
+    return code != NOP && code != OUT && code != HLT;
+}
+
+constexpr uint8_t ASSEMBLER_MAX_LABELS = 32;
+
+template <size_t size>
+struct assembler_result {
+    uint8_t image[size];
+    assembler_error error;
+    uint16_t line;  // Of the error, counting from 1.
+};
+
+// Fails the build with the error and its line in the instantiation context,
+// e.g. "assembler_check<ASSEMBLER_UNDEFINED_LABEL, 12>".
+template <assembler_error error, uint16_t line>
+struct assembler_check {
+    static_assert(error == ASSEMBLER_OK, "Program doesn't assemble.");
+
+    static constexpr bool ok = true;
+};
+
+// Two passes over the source: the first places labels, the second emits the
+// image once every label is known.
+template <size_t size>
+struct assembler {
+    static constexpr assembler_result<size> assemble(
+        const char* const source) {
+        assembler state{};
+        state.run(source, false);
+        if (state.result.error == ASSEMBLER_OK) {
+            state.run(source, true);
+        }
+
+        return state.result;
+    }
+
+   private:
+    typedef struct {
+        const char* name;
+        uint8_t length;
+        uint16_t address;
+    } label;
+
+    assembler_result<size> result        = {};
+    label labels[ASSEMBLER_MAX_LABELS] = {};
+    uint8_t label_count                = 0;
+    bool used[size]                    = {};
+
+    const char* position = nullptr;
+    uint16_t line        = 0;
+    uint16_t address     = 0;
+    bool emitting        = false;
+
+    static constexpr bool is_space(const char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    static constexpr bool is_digit(const char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    static constexpr bool is_identifier_start(const char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    }
+
+    static constexpr bool is_identifier(const char c) {
+        return is_identifier_start(c) || is_digit(c);
+    }
+
+    static constexpr char to_upper(const char c) {
+        return c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c;
+    }
+
+    static constexpr int8_t digit_value(const char c) {
+        if (is_digit(c)) {
+            return c - '0';
+        }
+        if (to_upper(c) >= 'A' && to_upper(c) <= 'F') {
+            return to_upper(c) - 'A' + 10;
+        }
+
+        return INT8_MAX;
+    }
+
+    // Records the first error only.
+    constexpr bool fail(const assembler_error error) {
+        if (result.error == ASSEMBLER_OK) {
+            result.error = error;
+            result.line  = line;
+        }
+
+        return false;
+    }
+
+    constexpr void skip_spaces(void) {
+        while (is_space(*position)) {
+            ++position;
+        }
+    }
+
+    constexpr bool at_end_of_statement(void) {
+        skip_spaces();
+
+        return *position == '\0' || *position == '\n' || *position == ';';
+    }
+
+    constexpr uint8_t read_identifier(void) {
+        const char* const start = position;
+        while (is_identifier(*position) && position - start < UINT8_MAX) {
+            ++position;
+        }
+
+        return position - start;
+    }
+
+    // Whether the identifier at `name` is `keyword`, ignoring case.
+    static constexpr bool matches(const char* const name, const uint8_t length,
+                                  const char* const keyword) {
+        for (uint8_t i = 0; i < length; ++i) {
+            if (keyword[i] == '\0' ||
+                to_upper(name[i]) != to_upper(keyword[i])) {
+                return false;
+            }
+        }
+
+        return keyword[length] == '\0';
+    }
+
+    constexpr const label* find_label(const char* const name,
+                                      const uint8_t length) const {
+        for (uint8_t i = 0; i < label_count; ++i) {
+            if (length != labels[i].length) {
+                continue;
+            }
+
+            uint8_t same = 0;
+            while (same < length && name[same] == labels[i].name[same]) {
+                ++same;
+            }
+            if (same == length) {
+                return &labels[i];
+            }
+        }
+
+        return nullptr;
+    }
+
+    constexpr bool define_label(const char* const name,
+                                const uint8_t length) {
+        if (emitting) {
+            return true;
+        }
+        if (find_label(name, length) != nullptr) {
+            return fail(ASSEMBLER_DUPLICATE_LABEL);
+        }
+        if (label_count == ASSEMBLER_MAX_LABELS) {
+            return fail(ASSEMBLER_TOO_MANY_LABELS);
+        }
+
+        labels[label_count++] = {name, length, address};
+
+        return true;
+    }
+
+    constexpr bool parse_number(uint16_t* const value) {
+        uint8_t base = 10;
+        if (position[0] == '0' && to_upper(position[1]) == 'X') {
+            base = 16;
+            position += 2;
+        } else if (position[0] == '0' && to_upper(position[1]) == 'B') {
+            base = 2;
+            position += 2;
+        }
+
+        // Saturates, so that the width checks catch what overflows.
+        uint32_t number = 0;
+        uint8_t digits  = 0;
+        for (; digit_value(*position) < base; ++position, ++digits) {
+            number = number * base + digit_value(*position);
+            if (number > UINT16_MAX) {
+                number = UINT16_MAX;
+            }
+        }
+        if (digits == 0 || is_identifier(*position)) {
+            return fail(ASSEMBLER_SYNTAX_ERROR);
+        }
+
+        *value = number;
+
+        return true;
+    }
+
+    // Labels read as 0 until the second pass knows them.
+    constexpr bool parse_value(uint16_t* const value) {
+        skip_spaces();
+        if (is_digit(*position)) {
+            return parse_number(value);
+        }
+        if (!is_identifier_start(*position)) {
+            return fail(ASSEMBLER_SYNTAX_ERROR);
+        }
+
+        const char* const name = position;
+        const uint8_t length   = read_identifier();
+        const label* const l   = find_label(name, length);
+        if (l != nullptr) {
+            *value = l->address;
+        } else if (emitting) {
+            return fail(ASSEMBLER_UNDEFINED_LABEL);
+        } else {
+            *value = 0;
+        }
+
+        return true;
+    }
+
+    constexpr bool emit(const uint8_t byte) {
+        if (address >= size) {
+            return fail(ASSEMBLER_OUT_OF_MEMORY);
+        }
+
+        if (emitting) {
+            result.image[address] = byte;
+        } else if (used[address]) {
+            return fail(ASSEMBLER_OVERLAP);
+        }
+        used[address] = true;
+        ++address;
+
+        return true;
+    }
+
+    constexpr bool parse_instruction(const char* const mnemonic,
+                                     const uint8_t length) {
+        uint8_t code = 0;
+        while (code < OP_CODE_COUNT &&
+               (assembler_mnemonics[code] == nullptr ||
+                !matches(mnemonic, length, assembler_mnemonics[code]))) {
+            ++code;
+        }
+        if (code == OP_CODE_COUNT) {
+            return fail(ASSEMBLER_UNKNOWN_MNEMONIC);
+        }
+
+        uint16_t operand = 0;
+        if (assembler_takes_operand((op_code)code)) {
+            if (at_end_of_statement()) {
+                return fail(ASSEMBLER_MISSING_OPERAND);
+            }
+            if (!parse_value(&operand)) {
+                return false;
+            }
+            if (operand >= BIT(OP_CODE_POS)) {
+                return fail(ASSEMBLER_VALUE_TOO_WIDE);
+            }
+        } else if (!at_end_of_statement()) {
+            return fail(ASSEMBLER_UNEXPECTED_OPERAND);
+        }
+
+        return emit(code << OP_CODE_POS | operand);
+    }
+
+    constexpr bool parse_directive(void) {
+        const char* const name = ++position;
+        const uint8_t length   = read_identifier();
+
+        if (matches(name, length, "byte")) {
+            for (;;) {
+                uint16_t value = 0;
+                if (!parse_value(&value)) {
+                    return false;
+                }
+                if (value > UINT8_MAX) {
+                    return fail(ASSEMBLER_VALUE_TOO_WIDE);
+                }
+                if (!emit(value)) {
+                    return false;
+                }
+
+                skip_spaces();
+                if (*position != ',') {
+                    return true;
+                }
+                ++position;
+            }
+        }
+
+        if (matches(name, length, "org")) {
+            skip_spaces();
+            uint16_t value = 0;
+            if (!parse_number(&value)) {
+                return false;
+            }
+            if (value > size) {
+                return fail(ASSEMBLER_OUT_OF_MEMORY);
+            }
+            address = value;
+
+            return true;
+        }
+
+        return fail(ASSEMBLER_UNKNOWN_DIRECTIVE);
+    }
+
+    // An optional label followed by an optional instruction or directive.
+    constexpr bool parse_statement(void) {
+        skip_spaces();
+        if (is_identifier_start(*position)) {
+            const char* const name = position;
+            const uint8_t length   = read_identifier();
+
+            skip_spaces();
+            if (*position != ':') {
+                return parse_instruction(name, length);
+            }
+            ++position;
+            if (!define_label(name, length)) {
+                return false;
+            }
+        }
+
+        skip_spaces();
+        if (is_identifier_start(*position)) {
+            const char* const name = position;
+            const uint8_t length   = read_identifier();
+            return parse_instruction(name, length);
+        }
+        if (*position == '.') {
+            return parse_directive();
+        }
+
+        return true;
+    }
+
+    constexpr void run(const char* const source, const bool emit_image) {
+        position = source;
+        line     = 1;
+        address  = 0;
+        emitting = emit_image;
+
+        while (*position != '\0') {
+            if (!parse_statement()) {
+                return;
+            }
+
+            if (!at_end_of_statement()) {
+                fail(ASSEMBLER_SYNTAX_ERROR);
+                return;
+            }
+            while (*position != '\0' && *position != '\n') {
+                ++position;
+            }
+            if (*position == '\n') {
+                ++position;
+                ++line;
+            }
+        }
+    }
+};
+
+template <size_t size>
+constexpr assembler_result<size> assemble(const char* const source) {
+    return assembler<size>::assemble(source);
+}
+
+#endif  // ASSEMBLER_H
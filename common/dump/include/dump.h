@@ -0,0 +1,27 @@
+#ifndef DUMP_H
+#define DUMP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+#include <stdint.h>
+
+#include "util.h"
+
+// Where the dump comes from and goes to, so that it runs the same against
+// the EEPROM and Serial as against memory and stdout.
+typedef struct {
+    void (*read)(uint8_t* const buffer, const uint16_t address,
+                 const uint16_t size);
+    void (*write)(const uint8_t* const data, const uint16_t size);
+} dump_config;
+
+void dump(const dump_config* const config, const uint16_t address,
+          const uint16_t size, const dump_format format);
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+
+#endif  // DUMP_H
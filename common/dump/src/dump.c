@@ -0,0 +1,80 @@
+#include "dump.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "util.h"
+
+static void write_line(const dump_config *const config,
+                       const char *const line, const uint8_t length) {
+    config->write((const uint8_t *)line, length);
+    config->write((const uint8_t *)"\r\n", 2);
+}
+
+// Lines start at multiples of HEX_FMT_ELEMENT_COUNT. In DUMP_FORMAT_HEX, runs
+// of full lines that repeat the one before are collapsed into a single "*",
+// like hexdump does. The last line is always printed to show where the dump
+// ends.
+void dump(const dump_config *const config, const uint16_t address,
+          const uint16_t size, const dump_format format) {
+    uint8_t previous[HEX_FMT_ELEMENT_COUNT];
+    bool has_previous = false;
+    bool collapsing   = false;
+
+    uint16_t addr      = address;
+    const uint16_t end = address + size;
+    while (addr < end) {
+        uint8_t increment =
+            HEX_FMT_ELEMENT_COUNT - (addr % HEX_FMT_ELEMENT_COUNT);
+        if (increment > end - addr) {
+            increment = end - addr;
+        }
+
+        uint8_t data[HEX_FMT_ELEMENT_COUNT];
+        config->read(data, addr, increment);
+
+        const bool is_full = increment == HEX_FMT_ELEMENT_COUNT;
+        const bool is_last = addr + increment == end;
+        switch (format) {
+            case DUMP_FORMAT_HEX: {
+                if (is_full && has_previous && !is_last &&
+                    memcmp(data, previous, sizeof(previous)) == 0) {
+                    if (!collapsing) {
+                        write_line(config, "*", 1);
+                        collapsing = true;
+                    }
+                    break;
+                }
+
+                collapsing   = false;
+                has_previous = is_full;
+                memcpy(previous, data, increment);
+
+                char line[HEX_FMT_BUFFER_SIZE];
+                write_line(config, line,
+                           format_data_as_hex(line, data, addr, increment));
+                break;
+            }
+            case DUMP_FORMAT_INTEL_HEX: {
+                char line[INTEL_HEX_FMT_BUFFER_SIZE];
+                write_line(
+                    config, line,
+                    format_data_as_intel_hex(line, data, addr, increment));
+                break;
+            }
+            case DUMP_FORMAT_BINARY:
+                config->write(data, increment);
+                break;
+            case DUMP_FORMAT_COUNT:
+                break;
+        }
+
+        addr += increment;
+    }
+
+    if (format == DUMP_FORMAT_INTEL_HEX) {
+        write_line(config, INTEL_HEX_END_OF_FILE,
+                   ARRAY_SIZE(INTEL_HEX_END_OF_FILE) - 1);
+    }
+}
@@ -5,14 +5,84 @@
 extern "C" {
 #endif  // __cplusplus
 
+#include <stdbool.h>
 #include <stdint.h>
 
+#include "eeprom.h"
+#include "util.h"
+
+// Wiring of the programmer board, in Arduino pin numbers. The address is
+// shifted out over SPI into two 74HC595s, whose outputs 0-12 drive A0-A12.
+#define EEPROM_PROGRAMMER_MOSI_PIN      11
+#define EEPROM_PROGRAMMER_SCK_PIN       13
+#define EEPROM_PROGRAMMER_LATCH_PIN     10
+#define EEPROM_PROGRAMMER_WRITE_EN_PIN  8
+#define EEPROM_PROGRAMMER_OUTPUT_EN_PIN 9
+#define EEPROM_PROGRAMMER_DATA_PINS     {14, 15, 16, 17, 4, 5, 6, 7}
+
+// Up to three chips share all of the above, with CE of chip i on shift
+// register output 13 + i. A board with a single socket ties CE low and leaves
+// chip 0 selected.
+#define EEPROM_PROGRAMMER_CHIP_COUNT      3
+#define EEPROM_PROGRAMMER_CHIP_ENABLE_POS 13
+
+// The last page is reserved for hashes of the programmed images, so that
+// checking for an unchanged image takes a single read. Chips holding several
+// images keep one hash per image, each in its own slot.
+#define EEPROM_PROGRAMMER_HASH_ADDRESS (EEPROM_SIZE - EEPROM_PAGE_SIZE)
+#define EEPROM_PROGRAMMER_HASH_SLOTS   (EEPROM_PAGE_SIZE / sizeof(uint32_t))
+
+// Stored while an image is being programmed. Reads back from an erased chip
+// too.
+#define EEPROM_PROGRAMMER_NO_HASH 0xffffffff
+
+// Fills `buffer` with the `size` bytes of the image at `address`, which never
+// cross a page boundary.
+typedef void (*eeprom_programmer_generator)(uint8_t* const buffer,
+                                            const uint16_t address,
+                                            const uint8_t size);
+
 void eeprom_programmer_init(void);
+
+// Gang programming: writes go to all `chips` at once and they run their write
+// cycles side by side. Reads, dumps and verifies see the lowest one.
+void eeprom_programmer_select(const uint8_t chips);
 void eeprom_programmer_read(uint8_t* const buffer, const uint16_t base_address,
                             const uint16_t size);
 void eeprom_programmer_write(const uint16_t base_address,
                              const uint8_t* const buffer, const uint16_t size);
-void eeprom_programmer_dump(const uint16_t address, const uint16_t size);
+void eeprom_programmer_begin_write(const uint16_t address,
+                                   const uint8_t* const buffer,
+                                   const uint8_t size);
+void eeprom_programmer_wait(void);
+uint16_t eeprom_programmer_update(const uint16_t base_address,
+                                  const uint8_t* const buffer,
+                                  const uint16_t size);
+uint16_t eeprom_programmer_write_generated(
+    const uint16_t base_address, const uint16_t size,
+    const eeprom_programmer_generator generate);
+uint32_t eeprom_programmer_read_hash(const uint8_t slot);
+void eeprom_programmer_write_hash(const uint8_t slot, const uint32_t hash);
+bool eeprom_programmer_verify(const uint16_t base_address, const uint16_t size,
+                              const uint32_t expected_crc);
+uint16_t eeprom_programmer_dump_mismatches(const uint16_t base_address,
+                                           const uint8_t* const expected,
+                                           const uint16_t size);
+void eeprom_programmer_dump(const uint16_t address, const uint16_t size,
+                            const dump_format format);
+
+// Prints the write cycle times measured since eeprom_programmer_init().
+void eeprom_programmer_print_write_cycles(void);
+
+// Prints where the time went since the last call: address shifts, the rest of
+// byte loads and reads, write cycle waits with a histogram of their latency,
+// page generators and serial dumps, along with the load throughput. The
+// measurements are only built in with EEPROM_PROGRAMMER_PROFILE defined.
+#ifdef EEPROM_PROGRAMMER_PROFILE
+void eeprom_programmer_print_profile(void);
+#else
+static inline void eeprom_programmer_print_profile(void) {}
+#endif  // EEPROM_PROGRAMMER_PROFILE
 
 #ifdef __cplusplus
 }
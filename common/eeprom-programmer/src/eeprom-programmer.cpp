@@ -2,70 +2,537 @@
 
 #include <Arduino.h>
 #include <HardwareSerial.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
+#include "dump.h"
 #include "eeprom.h"
+#include "pin-map.h"
 #include "shift-register.h"
 #include "util.h"
 
-static const shift_register_config address_shifter = {
-    .mosi_pin  = 11,
-    .sck_pin   = 13,
-    .latch_pin = 10,
+// The wiring is fixed, so the pins are resolved to port bits at compile time.
+// The data bus is PC0-PC3 and PD4-PD7 which takes one access per port.
+using latch     = pin_map_pin<EEPROM_PROGRAMMER_LATCH_PIN>;
+using write_en  = pin_map_pin<EEPROM_PROGRAMMER_WRITE_EN_PIN>;
+using output_en = pin_map_pin<EEPROM_PROGRAMMER_OUTPUT_EN_PIN>;
+using data_bus  = pin_map_bus<14, 15, 16, 17, 4, 5, 6, 7>;
+
+#ifdef EEPROM_PROGRAMMER_PROFILE
+
+// Where the time of a programming run goes, measured with micros(). Only one
+// span is open at a time. Page loads and reads are timed as a whole, as
+// micros() per byte would take about as long as the bytes. Only their first
+// address shift is timed, and as many more as they latched are split off into
+// PHASE_SHIFT at that rate.
+typedef enum {
+    PHASE_SHIFT,
+    PHASE_LOAD,
+    PHASE_READ,
+    PHASE_WAIT,
+    PHASE_GENERATE,  // Includes any serial output of the generator.
+    PHASE_SERIAL,
+
+    PHASE_COUNT,
+    NO_PHASE = PHASE_COUNT,
+} profile_phase;
+
+static const char* const phase_names[PHASE_COUNT] = {
+    [PHASE_SHIFT]    = "shift",
+    [PHASE_LOAD]     = "load",
+    [PHASE_READ]     = "read",
+    [PHASE_WAIT]     = "wait",
+    [PHASE_GENERATE] = "generate",
+    [PHASE_SERIAL]   = "serial",
+};
+
+// Page waits by the bit length of their latency in us, so bucket i holds
+// those under 2^i us.
+#define WAIT_BUCKET_COUNT 16
+
+static struct {
+    unsigned long phase_us[PHASE_COUNT];
+    uint16_t wait_buckets[WAIT_BUCKET_COUNT];
+    uint32_t bytes_loaded;
+
+    unsigned long start_us;
+    bool started;
+    profile_phase open;
+    unsigned long mark_us;
+    unsigned long shift_us;
+    uint16_t shifts;
+} profile;
+
+static void profile_reset(void) {
+    profile      = {};
+    profile.open = NO_PHASE;
+}
+
+static void profile_begin(const profile_phase phase) {
+    profile.mark_us = micros();
+    profile.open    = phase;
+
+    if (!profile.started) {
+        profile.start_us = profile.mark_us;
+        profile.started  = true;
+    }
+}
+
+// Charges the time since the last mark to `phase`.
+static unsigned long profile_lap(const profile_phase phase) {
+    const unsigned long now     = micros();
+    const unsigned long elapsed = now - profile.mark_us;
+
+    profile.phase_us[phase] += elapsed;
+    profile.mark_us         = now;
+
+    return elapsed;
+}
+
+static unsigned long profile_end(void) {
+    const unsigned long elapsed = profile_lap(profile.open);
+
+    if (profile.shifts > 0) {
+        unsigned long shift_us = profile.shift_us * profile.shifts;
+        shift_us               = shift_us < elapsed ? shift_us : elapsed;
+
+        profile.phase_us[profile.open] -= shift_us;
+        profile.phase_us[PHASE_SHIFT]  += shift_us;
+        profile.shifts                 = 0;
+    }
+    profile.open = NO_PHASE;
+
+    return elapsed;
+}
+
+static void profile_shifted(void) {
+    if (profile.open != PHASE_LOAD && profile.open != PHASE_READ) {
+        return;
+    }
+
+    if (profile.shifts == 0) {
+        profile.shift_us = micros() - profile.mark_us;
+    }
+    ++profile.shifts;
+}
+
+static void profile_waited(void) {
+    unsigned long elapsed = profile_end();
+
+    uint8_t bucket = 0;
+    while (elapsed != 0 && bucket < WAIT_BUCKET_COUNT - 1) {
+        elapsed >>= 1;
+        ++bucket;
+    }
+    ++profile.wait_buckets[bucket];
+}
+
+#define PROFILE_RESET()       profile_reset()
+#define PROFILE_BEGIN(phase)  profile_begin(phase)
+#define PROFILE_END()         (void)profile_end()
+#define PROFILE_SHIFTED()     profile_shifted()
+#define PROFILE_WAITED()      profile_waited()
+#define PROFILE_LOADED(count) (profile.bytes_loaded += (count))
+
+#else
+
+#define PROFILE_RESET()       ((void)0)
+#define PROFILE_BEGIN(phase)  ((void)0)
+#define PROFILE_END()         ((void)0)
+#define PROFILE_SHIFTED()     ((void)0)
+#define PROFILE_WAITED()      ((void)0)
+#define PROFILE_LOADED(count) ((void)0)
+
+#endif  // EEPROM_PROGRAMMER_PROFILE
+
+static void pulse_latch(void) {
+    latch::write(HIGH);
+    latch::write(LOW);
+    PROFILE_SHIFTED();
+}
+
+// Same as pinMode() on every pin.
+static void set_data_bus_mode(const uint8_t mode) {
+    if (mode != OUTPUT) {
+        data_bus::write(mode == INPUT_PULLUP ? MASK(7, 0) : 0);
+    }
+    data_bus::set_output(mode == OUTPUT);
+}
+
+static void write_data_bus(const uint8_t data) {
+    data_bus::write(data);
+}
+
+static uint8_t read_data_bus(void) {
+    return data_bus::read();
+}
+
+static void pulse_write_en(void) {
+    write_en::write(LOW);
+    write_en::write(HIGH);
+}
+
+static void write_output_en(const uint8_t level) {
+    output_en::write(level);
+}
+
+static constexpr shift_register_config address_shifter = {
+    .mosi_pin    = EEPROM_PROGRAMMER_MOSI_PIN,
+    .sck_pin     = EEPROM_PROGRAMMER_SCK_PIN,
+    .latch_pin   = latch::number,
+    .pulse_latch = pulse_latch,
+};
+
+static constexpr eeprom_bus bus = {
+    .set_data_bus_mode = set_data_bus_mode,
+    .write_data_bus    = write_data_bus,
+    .read_data_bus     = read_data_bus,
+    .pulse_write_en    = pulse_write_en,
+    .write_output_en   = write_output_en,
 };
 
-static const eeprom_config eeprom = {
+static constexpr eeprom_config eeprom = {
     .address_shifter = &address_shifter,
-    .write_en_pin    = 8,
-    .output_en_pin   = 9,
-    .data_pins       = {14, 15, 16, 17, 4, 5, 6, 7},
+    .write_en_pin    = write_en::number,
+    .output_en_pin   = output_en::number,
+    .data_pins       = EEPROM_PROGRAMMER_DATA_PINS,
+    .bus             = &bus,
+    .poll_mode       = EEPROM_DATA_POLLING,
+    .chip_count      = EEPROM_PROGRAMMER_CHIP_COUNT,
+    .chip_enable_pos = EEPROM_PROGRAMMER_CHIP_ENABLE_POS,
 };
 
+static_assert(data_bus::matches(eeprom.data_pins),
+              "Data bus doesn't match the config.");
+
+// Set while the chips run the write cycle of the last page.
+static bool write_pending;
+
+static uint8_t selected_chips;
+
 void eeprom_programmer_init(void) {
     (void)shift_register_init(&address_shifter);
     (void)eeprom_init(&eeprom);
+    selected_chips = BIT(0);
+    PROFILE_RESET();
+}
+
+void eeprom_programmer_select(const uint8_t chips) {
+    // The pending write cycle is polled on the chips it was written to.
+    eeprom_programmer_wait();
+
+    eeprom_select(&eeprom, chips);
+    selected_chips = chips;
+}
+
+// Bytes from `address` up to the end of its page, at most `remaining`.
+static uint16_t page_chunk_size(const uint16_t address,
+                                const uint16_t remaining) {
+    const uint16_t count = EEPROM_PAGE_SIZE - (address % EEPROM_PAGE_SIZE);
+
+    return count < remaining ? count : remaining;
 }
 
 void eeprom_programmer_read(uint8_t* const buffer, const uint16_t base_address,
                             const uint16_t size) {
+    eeprom_programmer_wait();
+
+    PROFILE_BEGIN(PHASE_READ);
     for (uint32_t i = 0; i < size; ++i) {
         buffer[i] = eeprom_read(&eeprom, base_address + i);
     }
+    PROFILE_END();
 }
 
 void eeprom_programmer_write(const uint16_t address,
                              const uint8_t* const buffer,
                              const uint16_t size) {
-    for (uint16_t offset = 0; offset < size; ++offset) {
-        const uint16_t addr = address + offset;
-        eeprom_write(&eeprom, addr, buffer[offset]);
-
-        // Wait if last page write or last write.
-        const uint16_t page_offset_mask = EEPROM_PAGE_SIZE - 1;
-        if ((addr & page_offset_mask) == page_offset_mask ||
-            offset == size - 1) {
-            eeprom_wait(&eeprom);
+    uint16_t offset = 0;
+    while (offset < size) {
+        const uint16_t addr  = address + offset;
+        const uint16_t count = page_chunk_size(addr, size - offset);
+
+        eeprom_programmer_begin_write(addr, &buffer[offset], count);
+        offset += count;
+    }
+
+    eeprom_programmer_wait();
+}
+
+// Loads `size` bytes, which must not cross a page boundary, and returns while
+// the chip runs the write cycle. Anything else that touches the chip waits for
+// it to complete first.
+void eeprom_programmer_begin_write(const uint16_t address,
+                                   const uint8_t* const buffer,
+                                   const uint8_t size) {
+    eeprom_programmer_wait();
+
+    PROFILE_BEGIN(PHASE_LOAD);
+    for (uint8_t offset = 0; offset < size; ++offset) {
+        eeprom_write(&eeprom, address + offset, buffer[offset]);
+    }
+    PROFILE_END();
+    PROFILE_LOADED(size);
+
+    write_pending = size > 0;
+}
+
+void eeprom_programmer_wait(void) {
+    if (write_pending) {
+        // A timeout shows up in the write cycle stats, and the data in a
+        // verify.
+        PROFILE_BEGIN(PHASE_WAIT);
+        (void)eeprom_wait(&eeprom);
+        PROFILE_WAITED();
+        write_pending = false;
+    }
+}
+
+// Writes the bytes of a page from the first to the last that differ from
+// `buffer` on any selected chip, if any, and returns while the chips run the
+// write cycle.
+static bool update_page(const uint16_t address, const uint8_t* const buffer,
+                        const uint8_t count) {
+    // Before selecting single chips, as the last page went to all of them.
+    eeprom_programmer_wait();
+
+    uint8_t first = count;
+    uint8_t last  = 0;
+    for (uint8_t chip = 0; chip < EEPROM_PROGRAMMER_CHIP_COUNT; ++chip) {
+        if ((selected_chips & BIT(chip)) == 0) {
+            continue;
+        }
+
+        // Reading in between the byte loads of a page write would end the
+        // load window, so the whole page is compared up front.
+        uint8_t page[EEPROM_PAGE_SIZE];
+        eeprom_select(&eeprom, BIT(chip));
+        eeprom_programmer_read(page, address, count);
+
+        for (uint8_t i = 0; i < count; ++i) {
+            if (page[i] != buffer[i]) {
+                first = i < first ? i : first;
+                last  = i > last ? i : last;
+            }
         }
     }
+    eeprom_select(&eeprom, selected_chips);
+
+    if (first == count) {
+        return false;
+    }
+
+    eeprom_programmer_begin_write(address + first, &buffer[first],
+                                  last - first + 1);
+
+    return true;
+}
+
+// Only pages that differ from `buffer` are written, and within those only the
+// bytes from the first to the last difference. Returns the number of pages
+// written. The last one may still be in its write cycle.
+uint16_t eeprom_programmer_update(const uint16_t base_address,
+                                  const uint8_t* const buffer,
+                                  const uint16_t size) {
+    uint16_t pages_written = 0;
+
+    uint16_t offset = 0;
+    while (offset < size) {
+        const uint16_t address = base_address + offset;
+        const uint16_t count   = page_chunk_size(address, size - offset);
+
+        pages_written += update_page(address, &buffer[offset], count);
+        offset += count;
+    }
+
+    return pages_written;
+}
+
+// Same as eeprom_programmer_update() with the data pulled from `generate` a
+// page at a time, into a single page buffer. Each page is generated while the
+// chip still runs the write cycle of the one before.
+uint16_t eeprom_programmer_write_generated(
+    const uint16_t base_address, const uint16_t size,
+    const eeprom_programmer_generator generate) {
+    uint16_t pages_written = 0;
+
+    uint16_t offset = 0;
+    while (offset < size) {
+        const uint16_t address = base_address + offset;
+        const uint16_t count   = page_chunk_size(address, size - offset);
+
+        uint8_t page[EEPROM_PAGE_SIZE];
+        PROFILE_BEGIN(PHASE_GENERATE);
+        generate(page, address, count);
+        PROFILE_END();
+        pages_written += update_page(address, page, count);
+
+        offset += count;
+    }
+
+    return pages_written;
+}
+
+static uint16_t hash_address(const uint8_t slot) {
+    return EEPROM_PROGRAMMER_HASH_ADDRESS + slot * sizeof(uint32_t);
+}
+
+uint32_t eeprom_programmer_read_hash(const uint8_t slot) {
+    uint8_t bytes[sizeof(uint32_t)];
+    eeprom_programmer_read(bytes, hash_address(slot), sizeof(bytes));
+
+    uint32_t hash = 0;
+    for (unsigned short i = 0; i < sizeof(bytes); ++i) {
+        hash |= (uint32_t)bytes[i] << (8 * i);
+    }
+
+    return hash;
+}
+
+void eeprom_programmer_write_hash(const uint8_t slot, const uint32_t hash) {
+    uint8_t bytes[sizeof(uint32_t)];
+    for (unsigned short i = 0; i < sizeof(bytes); ++i) {
+        bytes[i] = hash >> (8 * i);
+    }
+
+    (void)eeprom_programmer_update(hash_address(slot), bytes, sizeof(bytes));
+}
+
+// Compares the CRC-32 of the range, as computed by crc32_update(), without
+// sending anything over the serial port.
+bool eeprom_programmer_verify(const uint16_t base_address, const uint16_t size,
+                              const uint32_t expected_crc) {
+    uint32_t crc = 0;
+
+    uint16_t offset = 0;
+    while (offset < size) {
+        const uint16_t address = base_address + offset;
+        const uint16_t count   = page_chunk_size(address, size - offset);
+
+        uint8_t page[EEPROM_PAGE_SIZE];
+        eeprom_programmer_read(page, address, count);
+        crc = crc32_update(crc, page, count);
+
+        offset += count;
+    }
+
+    return crc == expected_crc;
 }
 
-void eeprom_programmer_dump(const uint16_t address, const uint16_t size) {
-    uint16_t addr      = address;
-    const uint16_t end = address + size;
-    while (addr < end) {
-        uint8_t increment =
-            HEX_FMT_ELEMENT_COUNT - (addr % HEX_FMT_ELEMENT_COUNT);
-        if (addr == (end & ~(HEX_FMT_ELEMENT_COUNT - 1))) {
-            increment = end - addr;
+// Dumps each page of the range that doesn't hold what `expected` does.
+// Returns the number of such pages.
+uint16_t eeprom_programmer_dump_mismatches(const uint16_t base_address,
+                                           const uint8_t* const expected,
+                                           const uint16_t size) {
+    uint16_t mismatches = 0;
+
+    uint16_t offset = 0;
+    while (offset < size) {
+        const uint16_t address = base_address + offset;
+        const uint16_t count   = page_chunk_size(address, size - offset);
+
+        uint8_t page[EEPROM_PAGE_SIZE];
+        eeprom_programmer_read(page, address, count);
+        if (memcmp(page, &expected[offset], count) != 0) {
+            Serial.print("Mismatch in page at ");
+            Serial.println(address, HEX);
+            eeprom_programmer_dump(address, count, DUMP_FORMAT_HEX);
+            ++mismatches;
         }
 
-        uint8_t data[HEX_FMT_ELEMENT_COUNT];
-        eeprom_programmer_read(data, addr, increment);
+        offset += count;
+    }
 
-        char buffer[HEX_FMT_BUFFER_SIZE];
-        format_data_as_hex(buffer, data, addr, increment);
-        Serial.println(buffer);
+    return mismatches;
+}
+
+static void serial_write(const uint8_t* const data, const uint16_t size) {
+    PROFILE_BEGIN(PHASE_SERIAL);
+    (void)Serial.write(data, size);
+    PROFILE_END();
+}
+
+// Serial only blocks while its TX buffer is full, and the UDRE interrupt
+// drains it in the background, so the EEPROM is read while the UART sends.
+static const dump_config serial_dump = {
+    .read  = eeprom_programmer_read,
+    .write = serial_write,
+};
 
-        addr += increment;
+void eeprom_programmer_dump(const uint16_t address, const uint16_t size,
+                            const dump_format format) {
+    dump(&serial_dump, address, size, format);
+}
+
+void eeprom_programmer_print_write_cycles(void) {
+    const eeprom_write_cycle_stats* const stats =
+        eeprom_get_write_cycle_stats();
+    if (stats->count == 0 && stats->timeouts == 0) {
+        return;
     }
+
+    Serial.print("Write cycles: ");
+    Serial.print(stats->count);
+    if (stats->count > 0) {
+        Serial.print(" timed, ");
+        Serial.print(stats->min_us);
+        Serial.print("/");
+        Serial.print(stats->total_us / stats->count);
+        Serial.print("/");
+        Serial.print(stats->max_us);
+        Serial.print(" us min/avg/max");
+    }
+    Serial.print(", ");
+    Serial.print(stats->timeouts);
+    Serial.println(" timeouts");
+}
+
+#ifdef EEPROM_PROGRAMMER_PROFILE
+void eeprom_programmer_print_profile(void) {
+    // The last page's write cycle belongs to the run too.
+    eeprom_programmer_wait();
+    if (!profile.started) {
+        return;
+    }
+
+    const unsigned long elapsed_ms = (micros() - profile.start_us) / 1000;
+
+    Serial.print("Profile: ");
+    Serial.print(profile.bytes_loaded);
+    Serial.print(" bytes loaded in ");
+    Serial.print(elapsed_ms);
+    Serial.print(" ms");
+    if (elapsed_ms > 0) {
+        Serial.print(", ");
+        Serial.print(profile.bytes_loaded * 1000 / elapsed_ms);
+        Serial.print(" bytes/s");
+    }
+    Serial.println();
+
+    for (uint8_t phase = 0; phase < PHASE_COUNT; ++phase) {
+        Serial.print(phase == 0 ? "  " : ", ");
+        Serial.print(phase_names[phase]);
+        Serial.print(" ");
+        Serial.print(profile.phase_us[phase]);
+        Serial.print(" us");
+    }
+    Serial.println();
+
+    Serial.print("  Page waits:");
+    for (uint8_t bucket = 0; bucket < WAIT_BUCKET_COUNT; ++bucket) {
+        if (profile.wait_buckets[bucket] == 0) {
+            continue;
+        }
+
+        const bool is_last = bucket == WAIT_BUCKET_COUNT - 1;
+        Serial.print(is_last ? " >=" : " <");
+        Serial.print(1UL << (is_last ? bucket - 1 : bucket));
+        Serial.print(" us: ");
+        Serial.print(profile.wait_buckets[bucket]);
+    }
+    Serial.println();
+
+    profile_reset();
 }
+#endif  // EEPROM_PROGRAMMER_PROFILE
@@ -9,20 +9,80 @@ extern "C" {
 
 #include "shift-register.h"
 
+// AT28C64B.
+#define EEPROM_SIZE      8192
 #define EEPROM_PAGE_SIZE 64
 
+// Polls for the end of a write cycle this often, and gives up after twice the
+// max write cycle time. (Section 16, AT28C64B Datasheet)
+#define EEPROM_POLL_INTERVAL_US 10
+#define EEPROM_WAIT_TIMEOUT_US  20000
+
+typedef enum {
+    // I/O7 reads the complement of the last byte written until the cycle is
+    // over. (Section 4.5, AT28C64B Datasheet)
+    EEPROM_DATA_POLLING,
+
+    // I/O6 toggles between reads until the cycle is over. Takes two reads
+    // with OE going high in between. (Section 4.6, AT28C64B Datasheet)
+    EEPROM_TOGGLE_BIT,
+} eeprom_poll_mode;
+
+// Fast path for a fixed wiring, e.g. built with pin-map. Each operation must
+// act on the pins given in the config.
+typedef struct {
+    void (*set_data_bus_mode)(const uint8_t mode);
+    void (*write_data_bus)(const uint8_t data);
+    uint8_t (*read_data_bus)(void);
+
+    // Drives WE low and back high.
+    void (*pulse_write_en)(void);
+    void (*write_output_en)(const uint8_t level);
+} eeprom_bus;
+
 typedef struct {
     const shift_register_config* address_shifter;
     uint8_t write_en_pin;
     uint8_t output_en_pin;
     uint8_t data_pins[8];
+
+    // Optional. The pins are driven one at a time when NULL.
+    const eeprom_bus* bus;
+
+    eeprom_poll_mode poll_mode;
+
+    // Chips that share the address, data and control lines, each with its CE
+    // on a shift register output from `chip_enable_pos` up. Two 74HC595s have
+    // room for 3 above A0-A12. 0 stands for a single chip with CE tied low.
+    uint8_t chip_count;
+    uint8_t chip_enable_pos;
 } eeprom_config;
 
+// Write cycles timed by eeprom_wait() since eeprom_init(), from the last byte
+// loaded to the first poll that sees the cycle over. That includes the page
+// load window. Cycles that were over by the first poll aren't counted.
+typedef struct {
+    uint16_t count;
+    uint16_t timeouts;
+    uint16_t min_us;
+    uint16_t max_us;
+    uint32_t total_us;
+} eeprom_write_cycle_stats;
+
+// Selects chip 0.
 int eeprom_init(const eeprom_config* const config);
+
+// Writes go to all `chips` at once and eeprom_wait() waits for all of them.
+// Reads come from the lowest one.
+void eeprom_select(const eeprom_config* const config, const uint8_t chips);
 void eeprom_write(const eeprom_config* const config, const uint16_t address,
                   const uint8_t data);
 uint8_t eeprom_read(const eeprom_config* const config, const uint16_t address);
-void eeprom_wait(const eeprom_config* const config);
+
+// Returns 0 once the last write cycle is over, or -1 after
+// EEPROM_WAIT_TIMEOUT_US.
+int eeprom_wait(const eeprom_config* const config);
+const eeprom_write_cycle_stats* eeprom_get_write_cycle_stats(void);
 
 #ifdef __cplusplus
 }
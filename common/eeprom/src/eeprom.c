@@ -2,20 +2,71 @@
 
 #include <Arduino.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "shift-register.h"
 #include "util.h"
 
+#define DATA_POLLING_MASK BIT(7)
+#define TOGGLE_BIT_MASK   BIT(6)
+
+static uint8_t selected_chips;
+static uint16_t last_address;
 static uint8_t last_byte;
+static unsigned long last_write_us;
+static eeprom_write_cycle_stats write_cycle_stats;
 
 static void set_data_bus_mode(const eeprom_config* const config,
                               uint8_t mode) {
+    if (config->bus != NULL) {
+        config->bus->set_data_bus_mode(mode);
+        return;
+    }
+
     for (unsigned short i = 0; i < ARRAY_SIZE(config->data_pins); ++i) {
         pinMode(config->data_pins[i], mode);
     }
 }
 
+static void write_data_bus(const eeprom_config* const config,
+                           const uint8_t data) {
+    if (config->bus != NULL) {
+        config->bus->write_data_bus(data);
+        return;
+    }
+
+    for (unsigned short i = 0; i < ARRAY_SIZE(config->data_pins); ++i) {
+        const bool bit = (data & BIT(i)) != 0;
+        digitalWrite(config->data_pins[i], bit);
+    }
+}
+
+static uint8_t read_data_bus(const eeprom_config* const config) {
+    if (config->bus != NULL) {
+        return config->bus->read_data_bus();
+    }
+
+    uint8_t data = 0;
+    for (unsigned short i = 0; i < ARRAY_SIZE(config->data_pins); ++i) {
+        const bool bit = digitalRead(config->data_pins[i]);
+        data |= bit << i;
+    }
+
+    return data;
+}
+
+static void write_output_en(const eeprom_config* const config,
+                            const uint8_t level) {
+    if (config->bus != NULL) {
+        config->bus->write_output_en(level);
+        return;
+    }
+
+    digitalWrite(config->output_en_pin, level);
+}
+
 int eeprom_init(const eeprom_config* const config) {
     // Ensure that WE outputs HIGH by default.
     pinMode(config->write_en_pin, INPUT_PULLUP);
@@ -28,62 +79,157 @@ int eeprom_init(const eeprom_config* const config) {
     // Have the data pins in high-impedance mode by default.
     set_data_bus_mode(config, INPUT);
 
+    memset(&write_cycle_stats, 0, sizeof(write_cycle_stats));
+    selected_chips = BIT(0);
+
     return 0;
 }
 
-uint8_t eeprom_read(const eeprom_config* const config,
-                    const uint16_t address) {
-    shift_register_write(config->address_shifter, address);
+static uint8_t chip_count(const eeprom_config* const config) {
+    return config->chip_count > 0 ? config->chip_count : 1;
+}
 
-    uint8_t data = 0;
-    for (unsigned short i = 0; i < ARRAY_SIZE(config->data_pins); ++i) {
-        const bool bit = digitalRead(config->data_pins[i]);
-        data |= bit << i;
+void eeprom_select(const eeprom_config* const config, const uint8_t chips) {
+    selected_chips = chips & MASK(chip_count(config) - 1, 0);
+}
+
+// Shifts out the address along with CE low on `chips` and high on the rest.
+static void select_address(const eeprom_config* const config,
+                           const uint16_t address, const uint8_t chips) {
+    uint16_t word = address;
+    for (uint8_t chip = 0; chip < config->chip_count; ++chip) {
+        if ((chips & BIT(chip)) == 0) {
+            // Up to bit 15, which a 16-bit int on AVR can't shift into.
+            word |= (uint16_t)1u << (config->chip_enable_pos + chip);
+        }
     }
 
-    return data;
+    shift_register_write(config->address_shifter, word);
+}
+
+uint8_t eeprom_read(const eeprom_config* const config,
+                    const uint16_t address) {
+    // Lowest set bit.
+    const uint8_t chip = selected_chips & -selected_chips;
+    select_address(config, address, chip);
+
+    return read_data_bus(config);
 }
 
 // For page writs, successive writes should be loaded within 150 us.
 // (Section 4.3, AT28C64B Datasheet)
 void eeprom_write(const eeprom_config* const config, const uint16_t address,
                   const uint8_t data) {
-    digitalWrite(config->output_en_pin, HIGH);  // Disable output.
+    write_output_en(config, HIGH);  // Disable output.
 
     // Minimum address hold time is 50 ns. (Section 16, AT28C64B Datasheet)
-    shift_register_write(config->address_shifter, address);
+    select_address(config, address, selected_chips);
 
     // Minimum data setup time is 50 ns before the end of write pulse.
     // (Section 16, AT28C64B Datasheet)
     set_data_bus_mode(config, OUTPUT);
-    for (unsigned short i = 0; i < ARRAY_SIZE(config->data_pins); ++i) {
-        const bool bit = (data & BIT(i)) != 0;
-        digitalWrite(config->data_pins[i], bit);
-    }
+    write_data_bus(config, data);
 
     // Send write pulse. Must be at least 50 ns wide. No delay is required
     // since a single instruction on Nano takes 62.5 ns (16 MHz).
     // (Section 16, AT28C64B Datasheet)
-    digitalWrite(config->write_en_pin, LOW);
-    digitalWrite(config->write_en_pin, HIGH);
+    if (config->bus != NULL) {
+        config->bus->pulse_write_en();
+    } else {
+        digitalWrite(config->write_en_pin, LOW);
+        digitalWrite(config->write_en_pin, HIGH);
+    }
 
     // No need to hold the data. (Section 16, AT28C64B Datasheet)
     set_data_bus_mode(config, INPUT);
 
-    digitalWrite(config->output_en_pin, LOW);  // Enable output.
+    write_output_en(config, LOW);  // Enable output.
 
-    last_byte = data;
+    last_address  = address;
+    last_byte     = data;
+    last_write_us = micros();
 }
 
-void eeprom_wait(const eeprom_config* const config) {
-    const unsigned short data_pin_count = ARRAY_SIZE(config->data_pins);
+static bool is_busy(const eeprom_config* const config) {
+    if (config->poll_mode == EEPROM_TOGGLE_BIT) {
+        const uint8_t first = read_data_bus(config);
+        write_output_en(config, HIGH);
+        write_output_en(config, LOW);
+
+        return ((first ^ read_data_bus(config)) & TOGGLE_BIT_MASK) != 0;
+    }
 
-    // Use I/O7 polling to check for pending write.
-    const uint8_t msb     = last_byte >> (data_pin_count - 1);
-    const uint8_t msb_pin = config->data_pins[data_pin_count - 1];
+    return ((read_data_bus(config) ^ last_byte) & DATA_POLLING_MASK) != 0;
+}
 
-    // Max write cycle time can be 10 ms. (Section 16, AT28C64B Datasheet)
-    while (digitalRead(msb_pin) != msb) {
-        delay(1);
+static void record_write_cycle(const uint16_t elapsed_us) {
+    eeprom_write_cycle_stats* const stats = &write_cycle_stats;
+    if (stats->count == 0 || elapsed_us < stats->min_us) {
+        stats->min_us = elapsed_us;
     }
+    if (elapsed_us > stats->max_us) {
+        stats->max_us = elapsed_us;
+    }
+    stats->total_us += elapsed_us;
+    ++stats->count;
+}
+
+// The first poll waits for most of the shortest cycle seen so far, and from
+// there on they are EEPROM_POLL_INTERVAL_US apart. Polling every millisecond
+// instead would round each cycle up to the next one.
+static int wait_chip(const eeprom_config* const config) {
+    const eeprom_write_cycle_stats* const stats = &write_cycle_stats;
+
+    // Early enough that the first poll still finds most cycles running, so
+    // that shorter ones keep getting timed.
+    const unsigned long first_poll_us = stats->min_us - stats->min_us / 16;
+    unsigned long elapsed_us          = micros() - last_write_us;
+    if (stats->count > 0 && elapsed_us < first_poll_us) {
+        delayMicroseconds(first_poll_us - elapsed_us);
+    }
+
+    if (!is_busy(config)) {
+        return 0;
+    }
+
+    for (;;) {
+        delayMicroseconds(EEPROM_POLL_INTERVAL_US);
+        elapsed_us = micros() - last_write_us;
+
+        if (!is_busy(config)) {
+            record_write_cycle(elapsed_us);
+            return 0;
+        }
+        if (elapsed_us > EEPROM_WAIT_TIMEOUT_US) {
+            ++write_cycle_stats.timeouts;
+            return -1;
+        }
+    }
+}
+
+// Selected chips run their write cycles at the same time, so waiting for them
+// one after the other takes about as long as for one.
+int eeprom_wait(const eeprom_config* const config) {
+    if (config->chip_count <= 1) {
+        return wait_chip(config);
+    }
+
+    int result = 0;
+    for (uint8_t chip = 0; chip < config->chip_count; ++chip) {
+        if ((selected_chips & BIT(chip)) == 0) {
+            continue;
+        }
+
+        // A single chip at a time, or they all drive the bus.
+        select_address(config, last_address, BIT(chip));
+        if (wait_chip(config) != 0) {
+            result = -1;
+        }
+    }
+
+    return result;
+}
+
+const eeprom_write_cycle_stats* eeprom_get_write_cycle_stats(void) {
+    return &write_cycle_stats;
 }
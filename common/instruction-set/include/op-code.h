@@ -19,6 +19,9 @@ typedef enum {
     JZ,
     OUT,
     HLT,
+    JNC,
+    JNZ,
+    ADO,  // ADD, with the sum latched into the output register too.
 
     OP_CODE_COUNT = 16,
 } op_code;
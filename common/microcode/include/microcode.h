@@ -0,0 +1,129 @@
+#ifndef MICROCODE_H
+#define MICROCODE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "op-code.h"
+#include "util.h"
+
+// Bits of a control word, which is wider than an int on AVR.
+constexpr uint32_t FI = UINT32_C(1) << 2;   // Flag register in.
+constexpr uint32_t J  = UINT32_C(1) << 1;   // Jump.
+constexpr uint32_t CO = UINT32_C(1) << 0;   // Program counter out.
+constexpr uint32_t CE = UINT32_C(1) << 3;   // Program counter enable.
+constexpr uint32_t OI = UINT32_C(1) << 4;   // Output register in.
+constexpr uint32_t BI = UINT32_C(1) << 5;   // B register in.
+constexpr uint32_t SU = UINT32_C(1) << 6;   // ALU subtract.
+constexpr uint32_t EO = UINT32_C(1) << 7;   // ALU out.
+constexpr uint32_t AO = UINT32_C(1) << 10;  // A register out.
+constexpr uint32_t AI = UINT32_C(1) << 9;   // A register in.
+constexpr uint32_t II = UINT32_C(1) << 8;   // Instruction register in.
+constexpr uint32_t IO = UINT32_C(1) << 11;  // Instruction register out.
+constexpr uint32_t RO = UINT32_C(1) << 12;  // RAM data out.
+constexpr uint32_t RI = UINT32_C(1) << 13;  // RAM data in.
+constexpr uint32_t MI = UINT32_C(1) << 14;  // Memory address register in.
+constexpr uint32_t HL = UINT32_C(1) << 15;  // Halt.
+
+// Clears the step counter as soon as it is decoded, so the step takes no
+// clock cycle and nothing else in it latches. Ends an instruction early.
+constexpr uint32_t SR = UINT32_C(1) << 16;  // Step counter reset.
+
+// A control word is spread over one EEPROM per byte, which all hold the same
+// image. The byte index is strapped on each chip's A7-A8.
+typedef enum {
+    LOWER_BYTE,
+    UPPER_BYTE,
+    RESET_BYTE,
+
+    BYTE_INDEX_COUNT,
+
+    // Room on the address lines for the byte index. The rest is left blank.
+    BYTE_INDEX_SLOTS = 4,
+} byte_index;
+
+typedef enum {
+    STEP_COUNT = 8,
+} step;
+
+typedef enum {
+    CARRY_FLAG,
+    ZERO_FLAG,
+
+    FLAG_COUNT = 2,
+} flag;
+
+// One flag bank of the microcode EEPROMs. The op code drives A0-A3, the step
+// A4-A6 and the byte index A7-A8. The flags select the bank above that.
+typedef struct {
+    uint8_t buffer[BYTE_INDEX_SLOTS][STEP_COUNT][OP_CODE_COUNT];
+} microcode_template;
+
+// All flag banks back to back, as programmed into the EEPROMs.
+typedef struct {
+    microcode_template banks[POW2(FLAG_COUNT)];
+} microcode_image;
+
+#define MICROCODE_IMAGE_SIZE sizeof(microcode_image)
+
+// Complete microcode sets, programmed one image after the other. A jumper on
+// A11 picks the one the machine runs. A12 is tied low: the upper half of the
+// chips is never programmed and holds the hashes, and a blank control word
+// would turn on every bus driver at once.
+typedef enum {
+    MICROCODE_FIXED_LENGTH,  // Every instruction takes all STEP_COUNT steps.
+    MICROCODE_EARLY_END,     // Instructions end with SR after their last step.
+
+    MICROCODE_SET_COUNT,
+} microcode_set;
+
+#define MICROCODE_SET_POS 11
+
+static_assert(MICROCODE_SET_COUNT <= 2, "The set is selected by A11 alone.");
+
+static const uint32_t fetch_cycle[] = {MI | CO, RO | II | CE};
+
+typedef struct {
+    bool is_conditional;
+
+    // Conditional instructions will only execute on these flags, or when
+    // negated, only when none of them is set.
+    uint8_t flags;
+    bool is_negated;
+
+    // Steps in the microcode after the fetch cycle. For MICROCODE_EARLY_END,
+    // the generator ends the instruction with SR after the last one that does
+    // anything.
+    uint32_t steps[STEP_COUNT - ARRAY_SIZE(fetch_cycle)];
+} microcode_metadata;
+
+// Both are kept in flash. Read them with pgm_read_byte() or memcpy_P().
+extern const microcode_metadata microcode[OP_CODE_COUNT];
+
+// Generated from `microcode` at compile time, indexed by microcode_set.
+extern const microcode_image microcode_eeprom_images[MICROCODE_SET_COUNT];
+
+// Address of a control byte in a microcode image, as laid out by programming
+// each flag bank's template back to back.
+static inline uint16_t microcode_address(const uint8_t flags,
+                                         const byte_index byte_index,
+                                         const uint8_t step,
+                                         const uint8_t op_code) {
+    return flags * sizeof(microcode_template) +
+           (byte_index * STEP_COUNT + step) * OP_CODE_COUNT + op_code;
+}
+
+// EEPROM address of the image of a set.
+static inline uint16_t microcode_set_address(const microcode_set set) {
+    return set << MICROCODE_SET_POS;
+}
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+
+#endif  // MICROCODE_H
@@ -0,0 +1,201 @@
+#include "microcode.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "op-code.h"
+#include "util.h"
+
+constexpr microcode_metadata microcode[OP_CODE_COUNT] PROGMEM = {
+    [NOP] =
+        {
+               .is_conditional = false,
+               .flags          = 0,
+               .is_negated     = false,
+               .steps          = {0, 0, 0, 0, 0, 0},
+               },
+    [LDA] =
+        {
+               .is_conditional = false,
+               .flags          = 0,
+               .is_negated     = false,
+               .steps          = {IO | MI, RO | AI, 0, 0, 0, 0},
+               },
+    [ADD] =
+        {
+               .is_conditional = false,
+               .flags          = 0,
+               .is_negated     = false,
+               .steps          = {IO | MI, RO | BI, EO | AI | FI, 0, 0, 0},
+               },
+    [SUB] =
+        {
+               .is_conditional = false,
+               .flags          = 0,
+               .is_negated     = false,
+               .steps          = {IO | MI, RO | BI, EO | AI | SU | FI, 0, 0, 0},
+               },
+
+    [STA] =
+        {
+               .is_conditional = false,
+               .flags          = 0,
+               .is_negated     = false,
+               .steps          = {IO | MI, AO | RI, 0, 0, 0, 0},
+               },
+
+    [LDI] =
+        {
+               .is_conditional = false,
+               .flags          = 0,
+               .is_negated     = false,
+               .steps          = {IO | AI, 0, 0, 0, 0, 0},
+               },
+
+    [ADI] =
+        {
+               .is_conditional = false,
+               .flags          = 0,
+               .is_negated     = false,
+               .steps          = {IO | BI, EO | AI | FI, 0, 0, 0, 0},
+               },
+    [SBI] =
+        {
+               .is_conditional = false,
+               .flags          = 0,
+               .is_negated     = false,
+               .steps          = {IO | BI, EO | AI | SU | FI, 0, 0, 0, 0},
+               },
+    [JMP] =
+        {
+               .is_conditional = false,
+               .flags          = 0,
+               .is_negated     = false,
+               .steps          = {IO | J, 0, 0, 0, 0, 0},
+               },
+    [JC] =
+        {
+               .is_conditional = true,
+               .flags          = BIT(CARRY_FLAG),
+               .is_negated     = false,
+               .steps          = {IO | J, 0, 0, 0, 0, 0},
+               },
+    [JZ] =
+        {
+               .is_conditional = true,
+               .flags          = BIT(ZERO_FLAG),
+               .is_negated     = false,
+               .steps          = {IO | J, 0, 0, 0, 0, 0},
+               },
+
+    [OUT] =
+        {
+               .is_conditional = false,
+               .flags          = 0,
+               .is_negated     = false,
+               .steps          = {AO | OI, 0, 0, 0, 0, 0},
+               },
+    [HLT] =
+        {
+               .is_conditional = false,
+               .flags          = 0,
+               .is_negated     = false,
+               .steps          = {HL, 0, 0, 0, 0, 0},
+               },
+    [JNC] =
+        {
+               .is_conditional = true,
+               .flags          = BIT(CARRY_FLAG),
+               .is_negated     = true,
+               .steps          = {IO | J, 0, 0, 0, 0, 0},
+               },
+    [JNZ] =
+        {
+               .is_conditional = true,
+               .flags          = BIT(ZERO_FLAG),
+               .is_negated     = true,
+               .steps          = {IO | J, 0, 0, 0, 0, 0},
+               },
+
+    // The output register latches the sum off the bus on the same edge as A.
+    [ADO] =
+        {
+               .is_conditional = false,
+               .flags          = 0,
+               .is_negated     = false,
+               .steps          = {IO | MI, RO | BI, EO | AI | FI | OI, 0, 0, 0},
+               },
+};
+
+static constexpr uint8_t get_byte(const uint32_t micro_instruction,
+                                  const byte_index byte_index) {
+    const uint8_t byte_pos = byte_index * 8;
+
+    return (micro_instruction >> byte_pos) & MASK(7, 0);
+}
+
+// Conditional instructions only run their steps in the banks of their flags,
+// or with negated ones, in the other banks.
+static constexpr uint32_t get_signals(const uint8_t flags,
+                                      const uint8_t op_code,
+                                      const uint8_t step) {
+    if (step < ARRAY_SIZE(fetch_cycle)) {
+        return fetch_cycle[step];
+    }
+
+    const microcode_metadata& metadata = microcode[op_code];
+    if (metadata.is_conditional &&
+        ((flags & metadata.flags) != 0) == metadata.is_negated) {
+        return 0;
+    }
+
+    return metadata.steps[step - ARRAY_SIZE(fetch_cycle)];
+}
+
+// With early ends, the step right after the last one with any signals resets
+// the step counter, so instructions only take as many cycles as they use.
+static constexpr uint32_t get_micro_instruction(const microcode_set set,
+                                                const uint8_t flags,
+                                                const uint8_t op_code,
+                                                const uint8_t step) {
+    const uint32_t signals = get_signals(flags, op_code, step);
+    if (set != MICROCODE_EARLY_END || signals != 0 || step == 0 ||
+        get_signals(flags, op_code, step - 1) == 0) {
+        return signals;
+    }
+
+    for (uint8_t later = step + 1; later < STEP_COUNT; ++later) {
+        if (get_signals(flags, op_code, later) != 0) {
+            return 0;
+        }
+    }
+
+    return SR;
+}
+
+static constexpr microcode_image generate_image(const microcode_set set) {
+    microcode_image image = {};
+    for (unsigned short flags = 0; flags < POW2(FLAG_COUNT); ++flags) {
+        for (unsigned short op_code = 0; op_code < OP_CODE_COUNT; ++op_code) {
+            for (unsigned short step = 0; step < STEP_COUNT; ++step) {
+                const uint32_t micro_instruction =
+                    get_micro_instruction(set, flags, op_code, step);
+
+                for (unsigned short bi = 0; bi < BYTE_INDEX_COUNT; ++bi) {
+                    image.banks[flags].buffer[bi][step][op_code] =
+                        get_byte(micro_instruction, (byte_index)bi);
+                }
+            }
+        }
+    }
+
+    return image;
+}
+
+static_assert(MICROCODE_IMAGE_SIZE == BIT(MICROCODE_SET_POS),
+              "Sets must start on their address line.");
+
+const microcode_image microcode_eeprom_images[MICROCODE_SET_COUNT] PROGMEM = {
+    [MICROCODE_FIXED_LENGTH] = generate_image(MICROCODE_FIXED_LENGTH),
+    [MICROCODE_EARLY_END]    = generate_image(MICROCODE_EARLY_END),
+};
@@ -0,0 +1,305 @@
+#ifndef PIN_MAP_H
+#define PIN_MAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __AVR__
+#include <avr/io.h>
+#endif  // __AVR__
+
+#include "util.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+// In the order of their register blocks in the I/O space.
+typedef enum {
+    PIN_MAP_PORT_B,
+    PIN_MAP_PORT_C,
+    PIN_MAP_PORT_D,
+
+    PIN_MAP_PORT_COUNT,
+} pin_map_port;
+
+// In the order of the registers within a block.
+typedef enum {
+    PIN_MAP_PIN,
+    PIN_MAP_DDR,
+    PIN_MAP_PORT,
+
+    PIN_MAP_REGISTER_COUNT,
+} pin_map_register;
+
+#ifndef __AVR__
+// Native builds go through a mock register file instead. Input pins read the
+// levels set with pin_map_mock_drive(), or their pull-up when nothing drives
+// them.
+typedef struct {
+    // Called before PINx is read so that device models can update the levels
+    // they drive.
+    void (*before_read)(const pin_map_port port, void* const context);
+
+    // Called after any register of `port` was written.
+    void (*after_write)(const pin_map_port port, const pin_map_register reg,
+                        void* const context);
+
+    void* context;
+} pin_map_mock_hooks;
+
+void pin_map_mock_reset(void);
+void pin_map_mock_set_hooks(const pin_map_mock_hooks* const hooks);
+uint8_t pin_map_mock_read(const pin_map_port port, const pin_map_register reg);
+void pin_map_mock_write(const pin_map_port port, const pin_map_register reg,
+                        const uint8_t value);
+void pin_map_mock_drive(const pin_map_port port, const uint8_t mask,
+                        const uint8_t levels);
+void pin_map_mock_release(const pin_map_port port, const uint8_t mask);
+#endif  // __AVR__
+
+static inline uint8_t pin_map_read(const pin_map_port port,
+                                   const pin_map_register reg) {
+#ifdef __AVR__
+    // PINx, DDRx and PORTx of ports B, C and D are laid out back to back.
+    // (Section 30, ATmega328P Datasheet)
+    return _SFR_IO8(_SFR_IO_ADDR(PINB) + port * PIN_MAP_REGISTER_COUNT + reg);
+#else
+    return pin_map_mock_read(port, reg);
+#endif  // __AVR__
+}
+
+static inline void pin_map_write(const pin_map_port port,
+                                 const pin_map_register reg,
+                                 const uint8_t value) {
+#ifdef __AVR__
+    _SFR_IO8(_SFR_IO_ADDR(PINB) + port * PIN_MAP_REGISTER_COUNT + reg) = value;
+#else
+    pin_map_mock_write(port, reg, value);
+#endif  // __AVR__
+}
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+
+#ifdef __cplusplus
+typedef struct {
+    pin_map_port port;
+    uint8_t bit;
+} pin_map_location;
+
+// Arduino pin numbering of the Nano. 20 and 21 are PB6 and PB7 as numbered by
+// MiniCore; the Nano uses them for the crystal.
+constexpr uint8_t PIN_MAP_PIN_COUNT = 22;
+
+constexpr pin_map_location pin_map_locate(const uint8_t pin) {
+    if (pin < 8) {
+        return {PIN_MAP_PORT_D, pin};
+    }
+    if (pin < 14) {
+        return {PIN_MAP_PORT_B, static_cast<uint8_t>(pin - 8)};
+    }
+    if (pin < 20) {
+        return {PIN_MAP_PORT_C, static_cast<uint8_t>(pin - 14)};
+    }
+
+    return {PIN_MAP_PORT_B, static_cast<uint8_t>(pin - 14)};
+}
+
+// A single pin with its register bit resolved at compile time. With constant
+// arguments, each operation compiles to a single sbi/cbi/sbic instruction.
+template <uint8_t pin>
+struct pin_map_pin {
+    static_assert(pin < PIN_MAP_PIN_COUNT, "Not a pin of the ATmega328P.");
+
+    static constexpr uint8_t number            = pin;
+    static constexpr pin_map_location location = pin_map_locate(pin);
+    static constexpr uint8_t mask              = BIT(location.bit);
+
+    static inline void set_output(const bool output) {
+        modify(PIN_MAP_DDR, output);
+    }
+
+    static inline void write(const bool level) {
+        modify(PIN_MAP_PORT, level);
+    }
+
+    static inline bool read(void) {
+        return (pin_map_read(location.port, PIN_MAP_PIN) & mask) != 0;
+    }
+
+   private:
+    static inline void modify(const pin_map_register reg, const bool set) {
+        const uint8_t value = pin_map_read(location.port, reg);
+        pin_map_write(location.port, reg, set ? value | mask : value & ~mask);
+    }
+};
+
+// A group of pins read and written as one value, bus bit i being `pins[i]`.
+// Bits that sit on the same port are moved with a single register access per
+// port, shifting them in one go when their order on the port is preserved.
+template <uint8_t... pins>
+struct pin_map_bus {
+    static constexpr uint8_t width = sizeof...(pins);
+    static_assert(width > 0 && width <= 8, "Bus must fit in a byte.");
+
+    static constexpr uint8_t pin_list[] = {pins...};
+
+    // Whether the bus is wired to `other`, e.g. the pins of a runtime config.
+    template <size_t count>
+    static constexpr bool matches(const uint8_t (&other)[count]) {
+        if (count != width) {
+            return false;
+        }
+        for (uint8_t i = 0; i < width; ++i) {
+            if (other[i] != pin_list[i]) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    static inline void set_output(const bool output) {
+        set_output_port<PIN_MAP_PORT_B>(output);
+        set_output_port<PIN_MAP_PORT_C>(output);
+        set_output_port<PIN_MAP_PORT_D>(output);
+    }
+
+    static inline void write(const uint8_t data) {
+        write_port<PIN_MAP_PORT_B>(data);
+        write_port<PIN_MAP_PORT_C>(data);
+        write_port<PIN_MAP_PORT_D>(data);
+    }
+
+    static inline uint8_t read(void) {
+        return read_port<PIN_MAP_PORT_B>() | read_port<PIN_MAP_PORT_C>() |
+               read_port<PIN_MAP_PORT_D>();
+    }
+
+   private:
+    // Marks ports whose bits can't be moved with a single shift.
+    static constexpr int8_t SCATTERED = INT8_MAX;
+
+    // Port bits of the bus on `port`.
+    static constexpr uint8_t port_mask(const pin_map_port port) {
+        uint8_t mask = 0;
+        for (uint8_t i = 0; i < width; ++i) {
+            const pin_map_location location = pin_map_locate(pin_list[i]);
+            if (location.port == port) {
+                mask |= BIT(location.bit);
+            }
+        }
+
+        return mask;
+    }
+
+    // Bus bits on `port`.
+    static constexpr uint8_t data_mask(const pin_map_port port) {
+        uint8_t mask = 0;
+        for (uint8_t i = 0; i < width; ++i) {
+            if (pin_map_locate(pin_list[i]).port == port) {
+                mask |= BIT(i);
+            }
+        }
+
+        return mask;
+    }
+
+    // Distance from the bus bits to the port bits on `port`.
+    static constexpr int8_t port_shift(const pin_map_port port) {
+        bool found   = false;
+        int8_t shift = 0;
+        for (uint8_t i = 0; i < width; ++i) {
+            const pin_map_location location = pin_map_locate(pin_list[i]);
+            if (location.port != port) {
+                continue;
+            }
+
+            const int8_t distance = location.bit - i;
+            if (found && distance != shift) {
+                return SCATTERED;
+            }
+            found = true;
+            shift = distance;
+        }
+
+        return shift;
+    }
+
+    template <pin_map_port port>
+    static inline uint8_t to_port(const uint8_t data) {
+        constexpr int8_t shift = port_shift(port);
+        constexpr uint8_t mask = data_mask(port);
+
+        if constexpr (shift == SCATTERED) {
+            uint8_t value = 0;
+            for (uint8_t i = 0; i < width; ++i) {
+                const pin_map_location location = pin_map_locate(pin_list[i]);
+                if (location.port == port && (data & BIT(i)) != 0) {
+                    value |= BIT(location.bit);
+                }
+            }
+            return value;
+        } else if constexpr (shift >= 0) {
+            return (data & mask) << shift;
+        } else {
+            return (data & mask) >> -shift;
+        }
+    }
+
+    template <pin_map_port port>
+    static inline uint8_t from_port(const uint8_t value) {
+        constexpr int8_t shift = port_shift(port);
+        constexpr uint8_t mask = port_mask(port);
+
+        if constexpr (shift == SCATTERED) {
+            uint8_t data = 0;
+            for (uint8_t i = 0; i < width; ++i) {
+                const pin_map_location location = pin_map_locate(pin_list[i]);
+                if (location.port == port && (value & BIT(location.bit)) != 0) {
+                    data |= BIT(i);
+                }
+            }
+            return data;
+        } else if constexpr (shift >= 0) {
+            return (value & mask) >> shift;
+        } else {
+            return (value & mask) << -shift;
+        }
+    }
+
+    template <pin_map_port port>
+    static inline void set_output_port(const bool output) {
+        constexpr uint8_t mask = port_mask(port);
+
+        if constexpr (mask != 0) {
+            const uint8_t ddr = pin_map_read(port, PIN_MAP_DDR);
+            pin_map_write(port, PIN_MAP_DDR, output ? ddr | mask : ddr & ~mask);
+        }
+    }
+
+    template <pin_map_port port>
+    static inline void write_port(const uint8_t data) {
+        constexpr uint8_t mask = port_mask(port);
+
+        if constexpr (mask != 0) {
+            const uint8_t value = pin_map_read(port, PIN_MAP_PORT) & ~mask;
+            pin_map_write(port, PIN_MAP_PORT, value | to_port<port>(data));
+        }
+    }
+
+    template <pin_map_port port>
+    static inline uint8_t read_port(void) {
+        if constexpr (port_mask(port) != 0) {
+            return from_port<port>(pin_map_read(port, PIN_MAP_PIN));
+        } else {
+            return 0;
+        }
+    }
+};
+#endif  // __cplusplus
+
+#endif  // PIN_MAP_H
@@ -0,0 +1,74 @@
+#include "pin-map.h"
+
+#ifndef __AVR__
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef struct {
+    uint8_t registers[PIN_MAP_REGISTER_COUNT];
+
+    // Input levels forced from outside the chip.
+    uint8_t driven;
+    uint8_t levels;
+} mock_port;
+
+static mock_port ports[PIN_MAP_PORT_COUNT];
+static const pin_map_mock_hooks* mock_hooks;
+
+void pin_map_mock_reset(void) {
+    memset(ports, 0, sizeof(ports));
+    mock_hooks = NULL;
+}
+
+void pin_map_mock_set_hooks(const pin_map_mock_hooks* const hooks) {
+    mock_hooks = hooks;
+}
+
+uint8_t pin_map_mock_read(const pin_map_port port, const pin_map_register reg) {
+    mock_port* const p = &ports[port];
+    if (reg != PIN_MAP_PIN) {
+        return p->registers[reg];
+    }
+
+    if (mock_hooks != NULL && mock_hooks->before_read != NULL) {
+        mock_hooks->before_read(port, mock_hooks->context);
+    }
+
+    const uint8_t ddr     = p->registers[PIN_MAP_DDR];
+    const uint8_t output  = p->registers[PIN_MAP_PORT];
+    const uint8_t pull_up = output & ~ddr & ~p->driven;
+    const uint8_t input   = (p->levels & p->driven) | pull_up;
+
+    return (output & ddr) | (input & ~ddr);
+}
+
+void pin_map_mock_write(const pin_map_port port, const pin_map_register reg,
+                        const uint8_t value) {
+    mock_port* const p = &ports[port];
+
+    // Writing ones to PINx toggles PORTx. (Section 13.2.2, ATmega328P
+    // Datasheet)
+    if (reg == PIN_MAP_PIN) {
+        p->registers[PIN_MAP_PORT] ^= value;
+    } else {
+        p->registers[reg] = value;
+    }
+
+    if (mock_hooks != NULL && mock_hooks->after_write != NULL) {
+        mock_hooks->after_write(port, reg == PIN_MAP_PIN ? PIN_MAP_PORT : reg,
+                                mock_hooks->context);
+    }
+}
+
+void pin_map_mock_drive(const pin_map_port port, const uint8_t mask,
+                        const uint8_t levels) {
+    mock_port* const p = &ports[port];
+    p->driven |= mask;
+    p->levels = (p->levels & ~mask) | (levels & mask);
+}
+
+void pin_map_mock_release(const pin_map_port port, const uint8_t mask) {
+    ports[port].driven &= ~mask;
+}
+#endif  // __AVR__
@@ -0,0 +1,87 @@
+#ifndef PROGRAMMER_PROTOCOL_H
+#define PROGRAMMER_PROTOCOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+#include <stdint.h>
+
+// Frames are laid out as:
+//
+//   sync | type | seq | address (LE) | size | payload | CRC-32 (LE)
+//
+// The CRC covers everything from type up to the end of the payload. The host
+// sends one frame at a time and waits for the reply carrying the same
+// sequence number, resending on NAK or timeout.
+#define PROGRAMMER_PROTOCOL_SYNC         0xa5
+#define PROGRAMMER_PROTOCOL_HEADER_SIZE  6
+#define PROGRAMMER_PROTOCOL_CRC_SIZE     4
+#define PROGRAMMER_PROTOCOL_MAX_PAYLOAD  64  // One EEPROM page.
+#define PROGRAMMER_PROTOCOL_MAX_FRAME_SIZE                                \
+    (PROGRAMMER_PROTOCOL_HEADER_SIZE + PROGRAMMER_PROTOCOL_MAX_PAYLOAD + \
+     PROGRAMMER_PROTOCOL_CRC_SIZE)
+
+#define PROGRAMMER_PROTOCOL_BAUD_RATE 115200
+
+// A frame that has been stalled this long is dropped, so that a corrupted size
+// doesn't swallow the frames resent after it. The host waits longer than this
+// for a reply, and for the line to go quiet before it resends.
+#define PROGRAMMER_PROTOCOL_IDLE_TIMEOUT_MS 50
+
+typedef enum {
+    // Host to device.
+    PROGRAMMER_BEGIN,   // Start of a session. Forgets the last sequence number.
+    PROGRAMMER_WRITE,   // Write the payload at address, within a page.
+    PROGRAMMER_READ,    // Read payload[0] bytes at address.
+    PROGRAMMER_FINISH,  // End of a session, once the last write is complete.
+
+    // Device to host.
+    PROGRAMMER_ACK,    // Done, or for writes, accepted.
+    PROGRAMMER_NAK,    // Corrupted. Resend.
+    PROGRAMMER_DATA,   // Reply to a read.
+    PROGRAMMER_ERROR,  // Invalid request. Resending won't help.
+
+    PROGRAMMER_FRAME_TYPE_COUNT,
+} programmer_frame_type;
+
+typedef struct {
+    uint8_t type;
+    uint8_t seq;
+    uint16_t address;
+    uint8_t size;
+    uint8_t payload[PROGRAMMER_PROTOCOL_MAX_PAYLOAD];
+} programmer_frame;
+
+typedef enum {
+    PROGRAMMER_PARSE_PENDING,
+    PROGRAMMER_PARSE_RECEIVED,
+    PROGRAMMER_PARSE_CORRUPT,
+} programmer_parse_status;
+
+// Assembles frames one byte at a time, as they come off the UART.
+typedef struct {
+    programmer_frame frame;
+    uint8_t position;
+    uint32_t crc;
+    uint32_t expected_crc;
+} programmer_parser;
+
+uint8_t programmer_protocol_encode(
+    uint8_t buffer[PROGRAMMER_PROTOCOL_MAX_FRAME_SIZE],
+    const programmer_frame* const frame);
+
+void programmer_parser_reset(programmer_parser* const parser);
+
+// Returns PROGRAMMER_PARSE_RECEIVED once parser->frame holds a complete frame
+// and PROGRAMMER_PARSE_CORRUPT when its CRC didn't match, in which case the
+// sequence number may be off too. Either way, the next byte starts a new
+// frame.
+programmer_parse_status programmer_parser_feed(programmer_parser* const parser,
+                                               const uint8_t byte);
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+
+#endif  // PROGRAMMER_PROTOCOL_H
@@ -0,0 +1,60 @@
+#ifndef PROGRAMMER_SERVER_H
+#define PROGRAMMER_SERVER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif  // __cplusplus
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "programmer-protocol.h"
+
+// The device's side of the protocol, on top of whatever holds the memory.
+typedef struct {
+    // Loads up to a page and returns while the write cycle runs.
+    void (*begin_write)(const uint16_t address, const uint8_t* const data,
+                        const uint8_t size);
+
+    // Blocks until the last write cycle is complete.
+    void (*wait)(void);
+
+    void (*read)(uint8_t* const buffer, const uint16_t address,
+                 const uint8_t size);
+    void (*send)(const uint8_t* const data, const uint8_t size);
+
+    uint16_t memory_size;
+    uint8_t page_size;
+
+    // Optional. Called on BEGIN and on FINISH, e.g. to take over a bus for the
+    // session and hand it back.
+    void (*begin)(void);
+    void (*finish)(void);
+} programmer_server_config;
+
+typedef struct {
+    const programmer_server_config* config;
+    programmer_parser parser;
+
+    // Between BEGIN and FINISH. WRITE and READ are refused outside of it.
+    bool is_open;
+
+    // Replies to a resent write are repeated without writing again.
+    bool has_last_write;
+    uint8_t last_write_seq;
+} programmer_server;
+
+void programmer_server_init(programmer_server* const server,
+                            const programmer_server_config* const config);
+void programmer_server_receive(programmer_server* const server,
+                               const uint8_t byte);
+
+// To be called once nothing was received for
+// PROGRAMMER_PROTOCOL_IDLE_TIMEOUT_MS.
+void programmer_server_idle(programmer_server* const server);
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+
+#endif  // PROGRAMMER_SERVER_H
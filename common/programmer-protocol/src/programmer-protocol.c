@@ -0,0 +1,105 @@
+#include "programmer-protocol.h"
+
+#include <stdint.h>
+
+#include "util.h"
+
+typedef enum {
+    SYNC_POS,
+    TYPE_POS,
+    SEQ_POS,
+    ADDRESS_LOW_POS,
+    ADDRESS_HIGH_POS,
+    SIZE_POS,
+    PAYLOAD_POS,
+} field_position;
+
+uint8_t programmer_protocol_encode(
+    uint8_t buffer[PROGRAMMER_PROTOCOL_MAX_FRAME_SIZE],
+    const programmer_frame *const frame) {
+    buffer[SYNC_POS]         = PROGRAMMER_PROTOCOL_SYNC;
+    buffer[TYPE_POS]         = frame->type;
+    buffer[SEQ_POS]          = frame->seq;
+    buffer[ADDRESS_LOW_POS]  = frame->address & 0xff;
+    buffer[ADDRESS_HIGH_POS] = frame->address >> 8;
+    buffer[SIZE_POS]         = frame->size;
+    for (uint8_t i = 0; i < frame->size; ++i) {
+        buffer[PAYLOAD_POS + i] = frame->payload[i];
+    }
+
+    const uint8_t crc_pos = PAYLOAD_POS + frame->size;
+    const uint32_t crc    = crc32_update(0, &buffer[TYPE_POS], crc_pos - 1);
+    for (uint8_t i = 0; i < PROGRAMMER_PROTOCOL_CRC_SIZE; ++i) {
+        buffer[crc_pos + i] = crc >> (8 * i);
+    }
+
+    return crc_pos + PROGRAMMER_PROTOCOL_CRC_SIZE;
+}
+
+void programmer_parser_reset(programmer_parser *const parser) {
+    parser->position     = SYNC_POS;
+    parser->crc          = 0;
+    parser->expected_crc = 0;
+}
+
+programmer_parse_status programmer_parser_feed(programmer_parser *const parser,
+                                               const uint8_t byte) {
+    programmer_frame *const frame = &parser->frame;
+    const uint8_t position        = parser->position++;
+
+    // Hunt for the start of a frame.
+    if (position == SYNC_POS) {
+        if (byte != PROGRAMMER_PROTOCOL_SYNC) {
+            programmer_parser_reset(parser);
+        }
+        return PROGRAMMER_PARSE_PENDING;
+    }
+
+    const uint8_t crc_pos = PAYLOAD_POS + frame->size;
+    if (position < crc_pos) {
+        parser->crc = crc32_update(parser->crc, &byte, 1);
+    }
+
+    switch (position) {
+        case TYPE_POS:
+            frame->type = byte;
+            break;
+        case SEQ_POS:
+            frame->seq = byte;
+            break;
+        case ADDRESS_LOW_POS:
+            frame->address = byte;
+            break;
+        case ADDRESS_HIGH_POS:
+            frame->address |= byte << 8;
+            break;
+        case SIZE_POS:
+            // Garbage that happened to start with a sync byte.
+            if (byte > PROGRAMMER_PROTOCOL_MAX_PAYLOAD) {
+                programmer_parser_reset(parser);
+                return PROGRAMMER_PARSE_CORRUPT;
+            }
+            frame->size = byte;
+            break;
+        default:
+            if (position < crc_pos) {
+                frame->payload[position - PAYLOAD_POS] = byte;
+                break;
+            }
+
+            parser->expected_crc |= (uint32_t)byte
+                                    << (8 * (position - crc_pos));
+            if (position < crc_pos + PROGRAMMER_PROTOCOL_CRC_SIZE - 1) {
+                break;
+            }
+
+            const uint32_t crc = parser->crc;
+            const uint32_t expected_crc = parser->expected_crc;
+            programmer_parser_reset(parser);
+
+            return crc == expected_crc ? PROGRAMMER_PARSE_RECEIVED
+                                       : PROGRAMMER_PARSE_CORRUPT;
+    }
+
+    return PROGRAMMER_PARSE_PENDING;
+}
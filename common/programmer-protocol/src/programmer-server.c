@@ -0,0 +1,127 @@
+#include "programmer-server.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "programmer-protocol.h"
+
+void programmer_server_init(programmer_server *const server,
+                            const programmer_server_config *const config) {
+    server->config         = config;
+    server->is_open        = false;
+    server->has_last_write = false;
+    server->last_write_seq = 0;
+    programmer_parser_reset(&server->parser);
+}
+
+// Replies are built in place of the request to spare the Nano's RAM. The
+// parser doesn't touch the frame again until the next byte comes in.
+static void reply(const programmer_server *const server,
+                  programmer_frame *const frame, const uint8_t type,
+                  const uint8_t size) {
+    frame->type = type;
+    frame->size = size;
+
+    uint8_t buffer[PROGRAMMER_PROTOCOL_MAX_FRAME_SIZE];
+    const uint8_t length = programmer_protocol_encode(buffer, frame);
+    server->config->send(buffer, length);
+}
+
+static bool is_in_range(const programmer_server_config *const config,
+                        const uint16_t address, const uint8_t size) {
+    return size > 0 && (uint32_t)address + size <= config->memory_size;
+}
+
+static uint8_t handle_write(programmer_server *const server,
+                            const programmer_frame *const frame) {
+    const programmer_server_config *const config = server->config;
+
+    // Outside of a session the memory may not be ours to write, e.g. the
+    // bootloader only holds the bus between BEGIN and FINISH.
+    if (!server->is_open) {
+        return PROGRAMMER_ERROR;
+    }
+
+    // The previous reply got lost. The data is already in.
+    if (server->has_last_write && frame->seq == server->last_write_seq) {
+        return PROGRAMMER_ACK;
+    }
+
+    const uint8_t page_offset = frame->address % config->page_size;
+    if (!is_in_range(config, frame->address, frame->size) ||
+        page_offset + frame->size > config->page_size) {
+        return PROGRAMMER_ERROR;
+    }
+
+    // Acknowledged as soon as the page is loaded, so that the host sends the
+    // next one while the chip is busy with the write cycle.
+    config->begin_write(frame->address, frame->payload, frame->size);
+    server->has_last_write = true;
+    server->last_write_seq = frame->seq;
+
+    return PROGRAMMER_ACK;
+}
+
+void programmer_server_receive(programmer_server *const server,
+                               const uint8_t byte) {
+    const programmer_parse_status status =
+        programmer_parser_feed(&server->parser, byte);
+    if (status == PROGRAMMER_PARSE_PENDING) {
+        return;
+    }
+
+    const programmer_server_config *const config = server->config;
+    programmer_frame *const frame                = &server->parser.frame;
+    if (status == PROGRAMMER_PARSE_CORRUPT) {
+        reply(server, frame, PROGRAMMER_NAK, 0);
+        return;
+    }
+
+    switch (frame->type) {
+        case PROGRAMMER_BEGIN:
+            config->wait();
+            if (config->begin != NULL) {
+                config->begin();
+            }
+            server->is_open        = true;
+            server->has_last_write = false;
+            reply(server, frame, PROGRAMMER_ACK, 0);
+            break;
+        case PROGRAMMER_WRITE:
+            reply(server, frame, handle_write(server, frame), 0);
+            break;
+        case PROGRAMMER_READ: {
+            const uint8_t count = frame->payload[0];
+            if (!server->is_open || frame->size != 1 ||
+                count > PROGRAMMER_PROTOCOL_MAX_PAYLOAD ||
+                !is_in_range(config, frame->address, count)) {
+                reply(server, frame, PROGRAMMER_ERROR, 0);
+                break;
+            }
+
+            config->wait();
+            config->read(frame->payload, frame->address, count);
+            reply(server, frame, PROGRAMMER_DATA, count);
+            break;
+        }
+        case PROGRAMMER_FINISH:
+            // A resent FINISH doesn't end the session twice.
+            if (server->is_open) {
+                config->wait();
+                if (config->finish != NULL) {
+                    config->finish();
+                }
+                server->is_open = false;
+            }
+            reply(server, frame, PROGRAMMER_ACK, 0);
+            break;
+        default:
+            reply(server, frame, PROGRAMMER_ERROR, 0);
+            break;
+    }
+}
+
+void programmer_server_idle(programmer_server *const server) {
+    programmer_parser_reset(&server->parser);
+}
@@ -14,6 +14,9 @@ typedef struct {
     const uint8_t mosi_pin;
     const uint8_t sck_pin;
     const uint8_t latch_pin;
+
+    // Optional fast path that drives the latch pin high and back low.
+    void (*const pulse_latch)(void);
 } shift_register_config;
 
 int shift_register_init(const shift_register_config* const config);
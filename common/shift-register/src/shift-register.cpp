@@ -34,6 +34,11 @@ void shift_register_write(const shift_register_config* const config,
     // single clock cycle on the Nano exceeds that (62.5 ns @ 16 MHz). So, no
     // extra delay is required.
     // (Section 6.6, SN74HC595 Datasheet)
+    if (config->pulse_latch != nullptr) {
+        config->pulse_latch();
+        return;
+    }
+
     digitalWrite(config->latch_pin, HIGH);
     digitalWrite(config->latch_pin, LOW);
 }
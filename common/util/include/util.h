@@ -7,6 +7,18 @@ extern "C" {
 
 #include <stdint.h>
 
+// Constant tables stay in flash on the AVR and are read with pgm_read_byte()
+// or memcpy_P(). Native builds have a single address space.
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#else
+#include <string.h>
+
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define memcpy_P               memcpy
+#endif  // __AVR__
+
 #define BIT(n)          (1 << (n))
 #define MASK(msb, lsb)  ((BIT((msb + 1) - lsb) - 1) << lsb)
 #define ARRAY_SIZE(arr) (sizeof(arr) / sizeof(arr[0]))
@@ -17,8 +29,31 @@ extern "C" {
 #define HEX_FMT_BUFFER_SIZE \
     (ARRAY_SIZE("000:") + HEX_FMT_ELEMENT_COUNT * ARRAY_SIZE(" 00") + 1)
 
-void format_data_as_hex(char* const buffer, const uint8_t* const data,
-                        const uint16_t address, const uint8_t size);
+// Record type, address, byte count and checksum around the data.
+#define INTEL_HEX_FMT_BUFFER_SIZE \
+    (ARRAY_SIZE(":00000000") + HEX_FMT_ELEMENT_COUNT * 2 + 2)
+
+typedef enum {
+    DUMP_FORMAT_HEX,        // Lines as formatted by format_data_as_hex().
+    DUMP_FORMAT_INTEL_HEX,  // Intel HEX data records.
+    DUMP_FORMAT_BINARY,     // Raw bytes.
+
+    DUMP_FORMAT_COUNT,
+} dump_format;
+
+// Both return the length of the line, which is NUL-terminated.
+uint8_t format_data_as_hex(char* const buffer, const uint8_t* const data,
+                           const uint16_t address, const uint8_t size);
+uint8_t format_data_as_intel_hex(char* const buffer, const uint8_t* const data,
+                                 const uint16_t address, const uint8_t size);
+
+// Record that ends an Intel HEX file.
+#define INTEL_HEX_END_OF_FILE ":00000001FF"
+
+// CRC-32 as used by zlib. Start with 0 and pass the previous result to
+// continue over more data.
+uint32_t crc32_update(const uint32_t crc, const uint8_t* const data,
+                      const uint16_t size);
 
 #ifdef __cplusplus
 }
@@ -1,22 +1,91 @@
 #include "util.h"
 
 #include <stdint.h>
-#include <stdio.h>
 
-void format_data_as_hex(char *const buffer, const uint8_t *const data,
-                        const uint16_t address, const uint8_t size) {
-    (void)sprintf(buffer, "%03x: ", address & ~(HEX_FMT_ELEMENT_COUNT - 1));
+static const char hex_digits[]       = "0123456789abcdef";
+static const char upper_hex_digits[] = "0123456789ABCDEF";
+
+static char *put_hex_byte(char *const out, const uint8_t byte,
+                          const char *const digits) {
+    out[0] = digits[byte >> 4];
+    out[1] = digits[byte & 0xf];
+
+    return out + 2;
+}
+
+uint8_t format_data_as_hex(char *const buffer, const uint8_t *const data,
+                           const uint16_t address, const uint8_t size) {
+    char *out = buffer;
+
+    // At least three digits, like "%03x".
+    const uint16_t line_address = address & ~(HEX_FMT_ELEMENT_COUNT - 1);
+    if (line_address > 0xfff) {
+        *out++ = hex_digits[line_address >> 12];
+    }
+    *out++ = hex_digits[(line_address >> 8) & 0xf];
+    out    = put_hex_byte(out, line_address & 0xff, hex_digits);
+    *out++ = ':';
+    *out++ = ' ';
 
     const unsigned short skipped = address % HEX_FMT_ELEMENT_COUNT;
     for (unsigned short i = 0; i < skipped + size; ++i) {
         if (i < skipped) {
-            (void)sprintf(buffer, "%s   ", buffer);
+            out[0] = ' ';
+            out[1] = ' ';
+            out[2] = ' ';
+            out += 3;
         } else {
-            (void)sprintf(buffer, "%s %02x", buffer, data[i]);
+            *out++ = ' ';
+            out    = put_hex_byte(out, data[i - skipped], hex_digits);
         }
 
         if (i % 8 == 7) {
-            (void)sprintf(buffer, "%s ", buffer);
+            *out++ = ' ';
         }
     }
+    *out = '\0';
+
+    return out - buffer;
+}
+
+uint8_t format_data_as_intel_hex(char *const buffer, const uint8_t *const data,
+                                 const uint16_t address, const uint8_t size) {
+    char *out = buffer;
+    *out++    = ':';
+
+    // Data record. The checksum makes all bytes of the record sum up to 0.
+    const uint8_t header[] = {size, (uint8_t)(address >> 8),
+                              (uint8_t)(address & 0xff), 0x00};
+    uint8_t sum            = 0;
+    for (unsigned short i = 0; i < ARRAY_SIZE(header); ++i) {
+        out = put_hex_byte(out, header[i], upper_hex_digits);
+        sum += header[i];
+    }
+    for (unsigned short i = 0; i < size; ++i) {
+        out = put_hex_byte(out, data[i], upper_hex_digits);
+        sum += data[i];
+    }
+    out  = put_hex_byte(out, (uint8_t)-sum, upper_hex_digits);
+    *out = '\0';
+
+    return out - buffer;
+}
+
+// One table entry per nibble keeps the table at 64 bytes of RAM on the Nano.
+static const uint32_t crc32_nibble_table[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4,
+    0x4db26158, 0x5005713c, 0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+    0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+};
+
+uint32_t crc32_update(const uint32_t crc, const uint8_t *const data,
+                      const uint16_t size) {
+    uint32_t value = ~crc;
+    for (uint16_t i = 0; i < size; ++i) {
+        value ^= data[i];
+        value = (value >> 4) ^ crc32_nibble_table[value & 0xf];
+        value = (value >> 4) ^ crc32_nibble_table[value & 0xf];
+    }
+
+    return ~value;
 }
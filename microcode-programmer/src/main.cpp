@@ -1,227 +1,145 @@
 #include <Arduino.h>
 #include <HardwareSerial.h>
-#include <stdbool.h>
 #include <stdint.h>
 
 #include "eeprom-programmer.h"
-#include "op-code.h"
+#include "microcode.h"
 #include "util.h"
 
-typedef enum {
-    FI = BIT(2),   // Flag register in.
-    J  = BIT(1),   // Jump.
-    CO = BIT(0),   // Program counter out.
-    CE = BIT(3),   // Program counter enable.
-    OI = BIT(4),   // Output register in.
-    BI = BIT(5),   // B register in.
-    SU = BIT(6),   // ALU subtract.
-    EO = BIT(7),   // ALU out.
-    AO = BIT(10),  // A register out.
-    AI = BIT(9),   // A register in.
-    II = BIT(8),   // Instruction register in.
-    IO = BIT(11),  // Instruction register out.
-    RO = BIT(12),  // RAM data out.
-    RI = BIT(13),  // RAM data in.
-    MI = BIT(14),  // Memory address register in.
-    HL = BIT(15),  // Halt.
-} control_signal;
-
-typedef enum {
-    LOWER_BYTE,
-    UPPER_BYTE,
-
-    BYTE_INDEX_COUNT,
-} byte_index;
-
-typedef enum {
-    STEP_COUNT = 8,
-} step;
-
-typedef enum {
-    CARRY_FLAG,
-    ZERO_FLAG,
-
-    FLAG_COUNT = 2,
-} flag;
-
-typedef struct {
-    uint8_t buffer[BYTE_INDEX_COUNT][STEP_COUNT][OP_CODE_COUNT];
-} microcode_template;
-
-static const uint16_t fetch_cycle[] = {MI | CO, RO | II | CE};
-
-typedef struct {
-    bool is_conditional;
-
-    // Conditional instructions will only execute on these flags.
-    uint8_t flags;
-
-    // Steps in the microcode after the fetch cycle.
-    uint16_t steps[STEP_COUNT - ARRAY_SIZE(fetch_cycle)];
-} microcode_metadata;
-
-static const microcode_metadata microcode[OP_CODE_COUNT] = {
-    [NOP] =
-        {
-               .is_conditional = false,
-               .flags          = 0,
-               .steps          = {0, 0, 0, 0, 0, 0},
-               },
-    [LDA] =
-        {
-               .is_conditional = false,
-               .flags          = 0,
-               .steps          = {IO | MI, RO | AI, 0, 0, 0, 0},
-               },
-    [ADD] =
-        {
-               .is_conditional = false,
-               .flags          = 0,
-               .steps          = {IO | MI, RO | BI, EO | AI | FI, 0, 0, 0},
-               },
-    [SUB] =
-        {
-               .is_conditional = false,
-               .flags          = 0,
-               .steps          = {IO | MI, RO | BI, EO | AI | SU | FI, 0, 0, 0},
-               },
-
-    [STA] =
-        {
-               .is_conditional = false,
-               .flags          = 0,
-               .steps          = {IO | MI, AO | RI, 0, 0, 0, 0},
-               },
-
-    [LDI] =
-        {
-               .is_conditional = false,
-               .flags          = 0,
-               .steps          = {IO | AI, 0, 0, 0, 0, 0},
-               },
-
-    [ADI] =
-        {
-               .is_conditional = false,
-               .flags          = 0,
-               .steps          = {IO | BI, EO | AI | FI, 0, 0, 0, 0},
-               },
-    [SBI] =
-        {
-               .is_conditional = false,
-               .flags          = 0,
-               .steps          = {IO | BI, EO | AI | SU | FI, 0, 0, 0, 0},
-               },
-    [JMP] =
-        {
-               .is_conditional = false,
-               .flags          = 0,
-               .steps          = {IO | J, 0, 0, 0, 0, 0},
-               },
-    [JC] =
-        {
-               .is_conditional = true,
-               .flags          = BIT(CARRY_FLAG),
-               .steps          = {IO | J, 0, 0, 0, 0, 0},
-               },
-    [JZ] =
-        {
-               .is_conditional = true,
-               .flags          = BIT(ZERO_FLAG),
-               .steps          = {IO | J, 0, 0, 0, 0, 0},
-               },
-
-    [OUT] =
-        {
-               .is_conditional = false,
-               .flags          = 0,
-               .steps          = {AO | OI, 0, 0, 0, 0, 0},
-               },
-    [HLT] =
-        {
-               .is_conditional = false,
-               .flags          = 0,
-               .steps          = {static_cast<uint16_t>(HL), 0, 0, 0, 0, 0},
-               },
-};
-
-static uint8_t get_byte(const uint16_t micro_instruction,
-                        const byte_index byte_index) {
-    const uint8_t byte_pos = byte_index * 8;
-
-    return (micro_instruction >> byte_pos) & MASK(7, 0);
+static_assert(MICROCODE_IMAGE_SIZE % EEPROM_PAGE_SIZE == 0,
+              "Image must be made of whole pages.");
+static_assert(MICROCODE_SET_COUNT * MICROCODE_IMAGE_SIZE <=
+                  EEPROM_PROGRAMMER_HASH_ADDRESS,
+              "Sets must not overlap the hashes.");
+static_assert(MICROCODE_SET_COUNT <= EEPROM_PROGRAMMER_HASH_SLOTS,
+              "Every set needs a hash slot.");
+
+// All three microcode EEPROMs hold the same image and are programmed together.
+// Set to BIT(0) on a board with a single socket.
+constexpr uint8_t CHIPS = MASK(EEPROM_PROGRAMMER_CHIP_COUNT - 1, 0);
+
+// The images of all sets are laid out in flash as in the EEPROMs, so EEPROM
+// addresses work as offsets into them. They are streamed out of flash a page
+// at a time.
+static void read_image_page(uint8_t page[EEPROM_PAGE_SIZE],
+                            const uint16_t address) {
+    memcpy_P(page, (const uint8_t*)microcode_eeprom_images + address,
+             EEPROM_PAGE_SIZE);
 }
 
-static void fill_template(microcode_template* const buffer) {
-    for (unsigned short op_code = 0; op_code < OP_CODE_COUNT; ++op_code) {
-        const microcode_metadata metadata = microcode[op_code];
-
-        for (unsigned short step = 0; step < STEP_COUNT; ++step) {
-            const uint16_t micro_instruction =
-                step < ARRAY_SIZE(fetch_cycle) ? fetch_cycle[step]
-                : metadata.is_conditional
-                    ? 0
-                    : metadata.steps[step - ARRAY_SIZE(fetch_cycle)];
-
-            for (unsigned short bi = 0; bi < BYTE_INDEX_COUNT; ++bi) {
-                buffer->buffer[bi][step][op_code] =
-                    get_byte(micro_instruction, (byte_index)bi);
-            }
-        }
+// Pulled by eeprom_programmer_write_generated(). One dot per flag bank.
+static void generate_page(uint8_t* const buffer, const uint16_t address,
+                          const uint8_t size) {
+    memcpy_P(buffer, (const uint8_t*)microcode_eeprom_images + address, size);
+
+    if ((address + size) % sizeof(microcode_template) == 0) {
+        Serial.print(".");
     }
 }
 
-static void update_template(microcode_template* const buffer,
-                            const uint8_t flags) {
-    if (flags == 0) {
-        return;
+// Each set is hashed on its own and its hash kept in the slot of the same
+// index, so that sets are programmed and verified independently.
+static uint32_t hash_set(const microcode_set set) {
+    const uint16_t base_address = microcode_set_address(set);
+
+    uint32_t hash = 0;
+    for (uint16_t address = base_address;
+         address < base_address + MICROCODE_IMAGE_SIZE;
+         address += EEPROM_PAGE_SIZE) {
+        uint8_t page[EEPROM_PAGE_SIZE];
+        read_image_page(page, address);
+        hash = crc32_update(hash, page, sizeof(page));
     }
 
-    for (unsigned short op_code = 0; op_code < OP_CODE_COUNT; ++op_code) {
-        const microcode_metadata metadata = microcode[op_code];
-        if (!metadata.is_conditional) {
-            continue;
-        }
+    return hash;
+}
 
-        for (unsigned short step = 0; step < ARRAY_SIZE(metadata.steps);
-             ++step) {
-            const uint16_t micro_instruction =
-                (flags & metadata.flags) != 0 ? metadata.steps[step] : 0;
-            for (unsigned short bi = 0; bi < BYTE_INDEX_COUNT; ++bi) {
-                buffer->buffer[bi][ARRAY_SIZE(fetch_cycle) + step][op_code] =
-                    get_byte(micro_instruction, (byte_index)bi);
-            }
+// Reads come from the lowest selected chip, so each one is checked on its
+// own.
+static bool is_up_to_date(const microcode_set set, const uint32_t hash) {
+    bool up_to_date = true;
+    for (uint8_t chip = 0; chip < EEPROM_PROGRAMMER_CHIP_COUNT; ++chip) {
+        if ((CHIPS & BIT(chip)) != 0) {
+            eeprom_programmer_select(BIT(chip));
+            up_to_date =
+                up_to_date && eeprom_programmer_read_hash(set) == hash;
         }
     }
+
+    return up_to_date;
 }
 
-static void program_eeprom(void) {
-    Serial.print("Programming EEPROM");
+static void program_set(const microcode_set set, const uint32_t hash) {
+    Serial.print("Set ");
+    Serial.print(set);
+    if (is_up_to_date(set, hash)) {
+        Serial.println(" is up to date");
+        return;
+    }
 
-    microcode_template buffer;
-    fill_template(&buffer);
+    eeprom_programmer_select(CHIPS);
 
-    for (unsigned short flag_mask = 0; flag_mask < POW2(FLAG_COUNT);
-         ++flag_mask) {
-        update_template(&buffer, flag_mask);
-        eeprom_programmer_write(flag_mask * sizeof(microcode_template),
-                                (const uint8_t*)buffer.buffer, sizeof(buffer));
-        Serial.print(".");
-    }
-    Serial.println(" done");
+    // Don't leave a stale hash behind if programming gets interrupted.
+    eeprom_programmer_write_hash(set, EEPROM_PROGRAMMER_NO_HASH);
+
+    Serial.print(": programming EEPROMs");
+
+    const uint16_t pages_written = eeprom_programmer_write_generated(
+        microcode_set_address(set), MICROCODE_IMAGE_SIZE, generate_page);
+
+    eeprom_programmer_write_hash(set, hash);
+
+    Serial.print(" done, ");
+    Serial.print(pages_written);
+    Serial.println(" pages written");
+    eeprom_programmer_print_write_cycles();
+    eeprom_programmer_print_profile();
 }
 
-static void dump_eeprom(void) {
-    Serial.println("Reading EEPROM");
-    eeprom_programmer_dump(0, POW2(FLAG_COUNT) * sizeof(microcode_template));
+static void verify_set(const uint8_t chip, const microcode_set set,
+                       const uint32_t hash) {
+    eeprom_programmer_select(BIT(chip));
+
+    const uint16_t base_address = microcode_set_address(set);
+
+    Serial.print("Verifying set ");
+    Serial.print(set);
+    Serial.print(" on EEPROM ");
+    Serial.print(chip);
+    if (eeprom_programmer_verify(base_address, MICROCODE_IMAGE_SIZE, hash)) {
+        Serial.println(" done");
+        return;
+    }
+    Serial.println(" failed");
+
+    for (uint16_t address = base_address;
+         address < base_address + MICROCODE_IMAGE_SIZE;
+         address += EEPROM_PAGE_SIZE) {
+        uint8_t page[EEPROM_PAGE_SIZE];
+        read_image_page(page, address);
+        (void)eeprom_programmer_dump_mismatches(address, page, sizeof(page));
+    }
 }
 
 void setup(void) {
     Serial.begin(115200);
     eeprom_programmer_init();
 
-    program_eeprom();
-    dump_eeprom();
+    uint32_t hashes[MICROCODE_SET_COUNT];
+    for (uint8_t set = 0; set < MICROCODE_SET_COUNT; ++set) {
+        hashes[set] = hash_set((microcode_set)set);
+        program_set((microcode_set)set, hashes[set]);
+    }
+
+    for (uint8_t chip = 0; chip < EEPROM_PROGRAMMER_CHIP_COUNT; ++chip) {
+        if ((CHIPS & BIT(chip)) == 0) {
+            continue;
+        }
+
+        for (uint8_t set = 0; set < MICROCODE_SET_COUNT; ++set) {
+            verify_set(chip, (microcode_set)set, hashes[set]);
+        }
+    }
 }
 
 void loop(void) {}
@@ -28,7 +28,9 @@ typedef enum {
 
 typedef enum {
     UNSIGNED,
-    SIGNED,
+    SIGNED,  // Two's complement.
+    HEXADECIMAL,
+    SIGNED_HEXADECIMAL,
 
     SYMBOL_TYPE_COUNT,
 } symbol_type;
@@ -44,6 +46,12 @@ typedef enum {
     SEVEN,
     EIGHT,
     NINE,
+    TEN,
+    ELEVEN,
+    TWELVE,
+    THIRTEEN,
+    FOURTEEN,
+    FIFTEEN,
 
     DECIMAL,
     MINUS,
@@ -67,6 +75,13 @@ constexpr uint8_t symbols[SYMBOL_COUNT] = {
     [EIGHT] = A | B | C | D | E | F | G,
     [NINE]  = A | B | C | D | F | G,
 
+    [TEN]      = A | B | C | E | F | G,
+    [ELEVEN]   = C | D | E | F | G,
+    [TWELVE]   = A | D | E | F,
+    [THIRTEEN] = B | C | D | E | G,
+    [FOURTEEN] = A | D | E | F | G,
+    [FIFTEEN]  = A | E | F | G,
+
     [DECIMAL] = DOT,
     [MINUS]   = G,
 };
@@ -74,14 +89,22 @@ constexpr uint8_t symbols[SYMBOL_COUNT] = {
 constexpr auto DISPLAY_POS     = 8;
 constexpr auto SYMBOL_TYPE_POS = 10;
 
-static uint8_t decode_number(const uint8_t number, const display display,
-                             const symbol_type type) {
-    uint8_t magnitude = number;
-    bool is_negative  = false;
+static constexpr uint8_t symbol_base(const symbol_type type) {
+    return type == HEXADECIMAL || type == SIGNED_HEXADECIMAL ? 16 : 10;
+}
+
+static constexpr uint8_t decode_number(const uint8_t number,
+                                       const display display,
+                                       const symbol_type type) {
+    const uint8_t base = symbol_base(type);
+    uint8_t magnitude  = number;
+    bool is_negative   = false;
     switch (type) {
         case UNSIGNED:
+        case HEXADECIMAL:
             break;
         case SIGNED:
+        case SIGNED_HEXADECIMAL:
             if ((int8_t)number < 0) {
                 magnitude   = -(int8_t)number;
                 is_negative = true;
@@ -93,13 +116,17 @@ static uint8_t decode_number(const uint8_t number, const display display,
 
     switch (display) {
         case HUNDREDS:
-            magnitude /= 10;
+            // Two hex digits cover a byte.
+            if (base == 16) {
+                break;
+            }
+            magnitude /= base;
             // Fallthrough.
         case TENS:
-            magnitude /= 10;
+            magnitude /= base;
             // Fallthrough.
         case ONES:
-            return symbols[ZERO + (magnitude % 10)];
+            return symbols[ZERO + (magnitude % base)];
         case SIGN:
             if (is_negative) {
                 return symbols[MINUS];
@@ -112,34 +139,102 @@ static uint8_t decode_number(const uint8_t number, const display display,
     return 0;
 }
 
-static void generate_data(uint8_t buffer[NUMBER_COUNT], const display display,
-                          const symbol_type type) {
-    for (unsigned int num = 0; num < NUMBER_COUNT; ++num) {
-        buffer[num] = decode_number((uint8_t)num, display, type);
+// Laid out by address: the symbol type drives A10-A11, the display A8-A9 and
+// the number A0-A7. The computer picks the symbol type with the upper address
+// lines, so it switches display modes without reprogramming.
+typedef struct {
+    uint8_t data[SYMBOL_TYPE_COUNT][DISPLAY_COUNT][NUMBER_COUNT];
+} decoder_image;
+
+static_assert(BIT(DISPLAY_POS) == NUMBER_COUNT &&
+                  BIT(SYMBOL_TYPE_POS) == DISPLAY_COUNT * NUMBER_COUNT,
+              "Image layout doesn't match the address lines.");
+static_assert(sizeof(decoder_image) <= EEPROM_PROGRAMMER_HASH_ADDRESS,
+              "Image overlaps the hash.");
+static_assert(sizeof(decoder_image) % EEPROM_PAGE_SIZE == 0,
+              "Image must be made of whole pages.");
+
+static constexpr decoder_image generate_image(void) {
+    decoder_image image = {};
+    for (unsigned short type = 0; type < SYMBOL_TYPE_COUNT; ++type) {
+        for (unsigned short place = 0; place < DISPLAY_COUNT; ++place) {
+            for (unsigned short num = 0; num < NUMBER_COUNT; ++num) {
+                image.data[type][place][num] =
+                    decode_number(num, (display)place, (symbol_type)type);
+            }
+        }
     }
+
+    return image;
 }
 
-static void program_eeprom(void) {
-    Serial.print("Programming EEPROM");
-    for (unsigned short place = 0; place < DISPLAY_COUNT; ++place) {
-        for (unsigned short type = 0; type < SYMBOL_TYPE_COUNT; ++type) {
-            // NOTE: Having a single large buffer exceeds Nano's RAM.
-            uint8_t buffer[NUMBER_COUNT];
-            generate_data(buffer, (display)place, (symbol_type)type);
-
-            const uint16_t base_address =
-                place << DISPLAY_POS | type << SYMBOL_TYPE_POS;
-            eeprom_programmer_write(base_address, buffer, ARRAY_SIZE(buffer));
-            Serial.print(".");
-        }
+static const decoder_image image PROGMEM = generate_image();
+
+// The image is streamed out of flash a page at a time.
+static void read_image_page(uint8_t page[EEPROM_PAGE_SIZE],
+                            const uint16_t address) {
+    memcpy_P(page, (const uint8_t*)&image + address, EEPROM_PAGE_SIZE);
+}
+
+// Pulled by eeprom_programmer_write_generated(). One dot per display.
+static void generate_page(uint8_t* const buffer, const uint16_t address,
+                          const uint8_t size) {
+    memcpy_P(buffer, (const uint8_t*)&image + address, size);
+
+    if ((address + size) % NUMBER_COUNT == 0) {
+        Serial.print(".");
     }
-    Serial.println(" done");
 }
 
-static void dump_eeprom(void) {
-    Serial.println("Reading EEPROM");
-    eeprom_programmer_dump(0,
-                           DISPLAY_COUNT * SYMBOL_TYPE_COUNT * NUMBER_COUNT);
+static uint32_t hash_image(void) {
+    uint32_t hash = 0;
+    for (uint16_t address = 0; address < sizeof(image);
+         address += EEPROM_PAGE_SIZE) {
+        uint8_t page[EEPROM_PAGE_SIZE];
+        read_image_page(page, address);
+        hash = crc32_update(hash, page, sizeof(page));
+    }
+
+    return hash;
+}
+
+static void program_eeprom(const uint32_t hash) {
+    if (eeprom_programmer_read_hash(0) == hash) {
+        Serial.println("EEPROM is up to date");
+        return;
+    }
+
+    // Don't leave a stale hash behind if programming gets interrupted.
+    eeprom_programmer_write_hash(0, EEPROM_PROGRAMMER_NO_HASH);
+
+    Serial.print("Programming EEPROM");
+
+    const uint16_t pages_written =
+        eeprom_programmer_write_generated(0, sizeof(image), generate_page);
+
+    eeprom_programmer_write_hash(0, hash);
+
+    Serial.print(" done, ");
+    Serial.print(pages_written);
+    Serial.println(" pages written");
+    eeprom_programmer_print_write_cycles();
+    eeprom_programmer_print_profile();
+}
+
+static void verify_eeprom(const uint32_t hash) {
+    Serial.print("Verifying EEPROM");
+    if (eeprom_programmer_verify(0, sizeof(image), hash)) {
+        Serial.println(" done");
+        return;
+    }
+    Serial.println(" failed");
+
+    for (uint16_t address = 0; address < sizeof(image);
+         address += EEPROM_PAGE_SIZE) {
+        uint8_t page[EEPROM_PAGE_SIZE];
+        read_image_page(page, address);
+        (void)eeprom_programmer_dump_mismatches(address, page, sizeof(page));
+    }
 }
 
 void setup(void) {
@@ -148,8 +243,9 @@ void setup(void) {
 
     eeprom_programmer_init();
 
-    program_eeprom();
-    dump_eeprom();
+    const uint32_t hash = hash_image();
+    program_eeprom(hash);
+    verify_eeprom(hash);
 }
 
 void loop(void) {}
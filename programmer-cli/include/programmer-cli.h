@@ -0,0 +1,12 @@
+#ifndef PROGRAMMER_CLI_H
+#define PROGRAMMER_CLI_H
+
+#include <stdint.h>
+
+// AT28C64B.
+constexpr uint16_t MEMORY_SIZE = 8192;
+
+// Everything main() does, so that the tests can run the CLI as it ships.
+int programmer_cli_main(int argc, char* argv[]);
+
+#endif  // PROGRAMMER_CLI_H
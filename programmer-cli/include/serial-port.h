@@ -0,0 +1,17 @@
+#ifndef SERIAL_PORT_H
+#define SERIAL_PORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Opens `path` in raw mode at `baud_rate`. Returns the file descriptor, or -1.
+int serial_port_open(const char* const path, const unsigned long baud_rate);
+
+// Returns 1 once a byte was read, 0 on timeout and -1 on error.
+int serial_port_read(const int fd, uint8_t* const byte,
+                     const int timeout_ms);
+
+int serial_port_write(const int fd, const uint8_t* const data,
+                      const size_t size);
+
+#endif  // SERIAL_PORT_H
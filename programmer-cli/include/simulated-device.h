@@ -0,0 +1,23 @@
+#ifndef SIMULATED_DEVICE_H
+#define SIMULATED_DEVICE_H
+
+#include <sys/types.h>
+
+typedef struct {
+    // Chance for each byte from the host to arrive corrupted.
+    unsigned int corrupt_percent;
+
+    // Time the simulated chip stays busy after a page write.
+    unsigned int write_cycle_us;
+} simulated_device_options;
+
+// Forks a process that runs programmer-server's protocol handling on top of a
+// simulated AT28C64B, behind a pseudo-terminal. Returns the host's end of the
+// terminal, or -1.
+int simulated_device_start(const simulated_device_options* const options,
+                           pid_t* const pid);
+
+// Waits for the device to exit once the host's end was closed.
+int simulated_device_stop(const pid_t pid);
+
+#endif  // SIMULATED_DEVICE_H
@@ -0,0 +1,8 @@
+#include "programmer-cli.h"
+
+// The tests bring their own main().
+#ifndef PIO_UNIT_TESTING
+int main(int argc, char* argv[]) {
+    return programmer_cli_main(argc, argv);
+}
+#endif  // PIO_UNIT_TESTING
@@ -0,0 +1,538 @@
+#include "programmer-cli.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dump.h"
+#include "programmer-protocol.h"
+#include "serial-port.h"
+#include "simulated-device.h"
+#include "util.h"
+
+constexpr uint8_t PAGE_SIZE = PROGRAMMER_PROTOCOL_MAX_PAYLOAD;
+
+// Covers a full write cycle plus a page worth of bytes on the wire.
+constexpr int REPLY_TIMEOUT_MS = 500;
+
+// With 1% of the bytes corrupted, about half of the page writes arrive
+// corrupted. One in 170 would then fail 8 times in a row, which ends most
+// full-chip writes.
+constexpr unsigned int MAX_ATTEMPTS = 16;
+
+// Long enough for the device to drop a partial frame on its idle timeout, with
+// room for the latency of USB serial adapters.
+constexpr int RESYNC_TIMEOUT_MS = 2 * PROGRAMMER_PROTOCOL_IDLE_TIMEOUT_MS;
+
+// The Nano sits in its bootloader for a while after the port resets it.
+constexpr unsigned int RESET_DELAY_US = 2000000;
+
+// How often -w checks whether the image changed.
+constexpr unsigned int WATCH_INTERVAL_US = 250000;
+
+// Max write cycle time. (Section 16, AT28C64B Datasheet)
+constexpr unsigned int WRITE_CYCLE_US = 10000;
+
+// Indexed by dump_format.
+static const char* const dump_format_names[DUMP_FORMAT_COUNT] = {
+    "hex",
+    "ihex",
+    "bin",
+};
+
+typedef struct {
+    const char* port;
+    unsigned long baud_rate;
+    bool simulate;
+    unsigned int corrupt_percent;
+    uint16_t address;
+    bool verify;
+    uint16_t dump_size;
+    dump_format format;
+    const char* image_path;
+    bool watch;
+} options;
+
+typedef struct {
+    int fd;
+    uint8_t seq;
+    programmer_parser parser;
+
+    unsigned long frames;
+    unsigned long resends;
+} session;
+
+typedef enum {
+    REPLY_RECEIVED,
+    REPLY_MISSING,
+    REPLY_FAILED,
+} reply_status;
+
+static void usage(const char* const name) {
+    fprintf(stderr,
+            "Usage: %s device [-a address] [-v] [-w] image\n"
+            "       %s device [-a address] -d size [-f format]\n"
+            "\n"
+            "  device is -p port [-b baud] or -s [-e percent].\n"
+            "\n"
+            "  -p port     Serial port of the programmer-server or the\n"
+            "              bootloader.\n"
+            "  -b baud     Defaults to 115200. The bootloader runs at 38400.\n"
+            "  -s          Use a simulated device on a pseudo-terminal.\n"
+            "  -e percent  Chance for each byte the simulated device\n"
+            "              receives to be corrupted.\n"
+            "  -a address  Where the image or dump starts. Defaults to 0.\n"
+            "  -v          Read the image back after writing it.\n"
+            "  -w          Keep the port open and write the image again each\n"
+            "              time it changes. Only the first write waits for\n"
+            "              the Nano to come out of reset.\n"
+            "  -d size     Dump `size` bytes instead of writing.\n"
+            "  -f format   hex (default), ihex or bin.\n",
+            name, name);
+}
+
+static int parse_options(options* const opts, const int argc,
+                         char* const argv[]) {
+    *opts = {
+        .port            = nullptr,
+        .baud_rate       = PROGRAMMER_PROTOCOL_BAUD_RATE,
+        .simulate        = false,
+        .corrupt_percent = 0,
+        .address         = 0,
+        .verify          = false,
+        .dump_size       = 0,
+        .format          = DUMP_FORMAT_HEX,
+        .image_path      = nullptr,
+        .watch           = false,
+    };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:b:se:a:vwd:f:")) != -1) {
+        switch (opt) {
+            case 'p':
+                opts->port = optarg;
+                break;
+            case 'b':
+                opts->baud_rate = strtoul(optarg, nullptr, 0);
+                break;
+            case 's':
+                opts->simulate = true;
+                break;
+            case 'e':
+                opts->corrupt_percent = strtoul(optarg, nullptr, 0);
+                break;
+            case 'a':
+                opts->address = strtoul(optarg, nullptr, 0);
+                break;
+            case 'v':
+                opts->verify = true;
+                break;
+            case 'w':
+                opts->watch = true;
+                break;
+            case 'd':
+                opts->dump_size = strtoul(optarg, nullptr, 0);
+                break;
+            case 'f':
+                opts->format = DUMP_FORMAT_COUNT;
+                for (unsigned short i = 0; i < DUMP_FORMAT_COUNT; ++i) {
+                    if (strcmp(optarg, dump_format_names[i]) == 0) {
+                        opts->format = (dump_format)i;
+                    }
+                }
+                if (opts->format == DUMP_FORMAT_COUNT) {
+                    return -1;
+                }
+                break;
+            default:
+                return -1;
+        }
+    }
+
+    if (optind < argc) {
+        opts->image_path = argv[optind];
+    }
+
+    const bool has_device = (opts->port != nullptr) != opts->simulate;
+    const bool has_job = (opts->image_path != nullptr) != (opts->dump_size > 0);
+    if (!has_device || !has_job || opts->corrupt_percent > 100 ||
+        opts->address >= MEMORY_SIZE ||
+        (opts->watch && opts->image_path == nullptr)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int load_image(uint8_t image[MEMORY_SIZE], uint16_t* const size,
+                      const char* const path, const uint16_t address) {
+    FILE* const file = fopen(path, "rb");
+    if (file == nullptr) {
+        perror(path);
+        return -1;
+    }
+
+    const uint16_t capacity = MEMORY_SIZE - address;
+    *size                   = fread(image, 1, capacity, file);
+    const bool too_large    = fgetc(file) != EOF;
+    (void)fclose(file);
+
+    if (too_large) {
+        fprintf(stderr, "%s: doesn't fit in %u bytes\n", path, capacity);
+        return -1;
+    }
+
+    return 0;
+}
+
+static double now(void) {
+    struct timespec ts;
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static reply_status await_reply(session* const s, const uint8_t seq,
+                                programmer_frame* const reply) {
+    for (;;) {
+        uint8_t byte;
+        const int result = serial_port_read(s->fd, &byte, REPLY_TIMEOUT_MS);
+        if (result < 0) {
+            perror("read");
+            return REPLY_FAILED;
+        }
+        if (result == 0) {
+            return REPLY_MISSING;
+        }
+
+        const programmer_parse_status status =
+            programmer_parser_feed(&s->parser, byte);
+        if (status == PROGRAMMER_PARSE_CORRUPT) {
+            return REPLY_MISSING;
+        }
+
+        // Replies to earlier copies of a resent frame are stale.
+        if (status == PROGRAMMER_PARSE_RECEIVED &&
+            (s->parser.frame.seq == seq ||
+             s->parser.frame.type == PROGRAMMER_NAK)) {
+            *reply = s->parser.frame;
+            return REPLY_RECEIVED;
+        }
+    }
+}
+
+// Waits for the line to go quiet before a resend, and drops whatever came in
+// meanwhile. The device NAKs a corrupted frame as soon as it is parsed, while
+// the rest of it may still be on the way. A sync byte in there would start a
+// bogus frame that swallows the resend, and stale NAKs would trigger more
+// resends, which get corrupted the same way.
+static int resync(session* const s) {
+    for (;;) {
+        uint8_t byte;
+        const int result = serial_port_read(s->fd, &byte, RESYNC_TIMEOUT_MS);
+        if (result < 0) {
+            perror("read");
+            return -1;
+        }
+        if (result == 0) {
+            break;
+        }
+    }
+    programmer_parser_reset(&s->parser);
+
+    return 0;
+}
+
+// Sends `request` until the device replies with anything but a NAK.
+static int transact(session* const s, programmer_frame* const request,
+                    programmer_frame* const reply) {
+    request->seq = s->seq++;
+
+    uint8_t buffer[PROGRAMMER_PROTOCOL_MAX_FRAME_SIZE];
+    const uint8_t length = programmer_protocol_encode(buffer, request);
+
+    for (unsigned int attempt = 0; attempt < MAX_ATTEMPTS; ++attempt) {
+        if (attempt > 0) {
+            if (resync(s) != 0) {
+                return -1;
+            }
+            ++s->resends;
+        }
+        ++s->frames;
+
+        if (serial_port_write(s->fd, buffer, length) != 0) {
+            perror("write");
+            return -1;
+        }
+
+        switch (await_reply(s, request->seq, reply)) {
+            case REPLY_RECEIVED:
+                if (reply->type == PROGRAMMER_ERROR) {
+                    fprintf(stderr, "device rejected %u bytes at %04x\n",
+                            request->size, request->address);
+                    return -1;
+                }
+                if (reply->type != PROGRAMMER_NAK) {
+                    return 0;
+                }
+                break;
+            case REPLY_MISSING:
+                break;
+            case REPLY_FAILED:
+                return -1;
+        }
+    }
+
+    fprintf(stderr, "no reply after %u attempts\n", MAX_ATTEMPTS);
+    return -1;
+}
+
+static int send_command(session* const s, const uint8_t type) {
+    programmer_frame request = {};
+    request.type             = type;
+
+    programmer_frame reply;
+    return transact(s, &request, &reply);
+}
+
+// Writes each page in a single frame. The device acknowledges a page before
+// its write cycle is done, so the cycle overlaps with sending the next one.
+static int write_image(session* const s, const uint8_t* const image,
+                       const uint16_t address, const uint16_t size) {
+    uint16_t offset = 0;
+    while (offset < size) {
+        const uint16_t addr = address + offset;
+
+        uint16_t count = PAGE_SIZE - (addr % PAGE_SIZE);
+        if (count > size - offset) {
+            count = size - offset;
+        }
+
+        programmer_frame request = {};
+        request.type             = PROGRAMMER_WRITE;
+        request.address          = addr;
+        request.size             = count;
+        memcpy(request.payload, &image[offset], count);
+
+        programmer_frame reply;
+        if (transact(s, &request, &reply) != 0) {
+            return -1;
+        }
+
+        offset += count;
+    }
+
+    return 0;
+}
+
+static int read_memory(session* const s, uint8_t* const buffer,
+                       const uint16_t address, const uint16_t size) {
+    uint16_t offset = 0;
+    while (offset < size) {
+        uint16_t count = size - offset;
+        if (count > PROGRAMMER_PROTOCOL_MAX_PAYLOAD) {
+            count = PROGRAMMER_PROTOCOL_MAX_PAYLOAD;
+        }
+
+        programmer_frame request = {};
+        request.type             = PROGRAMMER_READ;
+        request.address          = address + offset;
+        request.size             = 1;
+        request.payload[0]       = count;
+
+        programmer_frame reply;
+        if (transact(s, &request, &reply) != 0) {
+            return -1;
+        }
+        if (reply.type != PROGRAMMER_DATA || reply.size != count) {
+            fprintf(stderr, "unexpected reply to read at %04x\n",
+                    request.address);
+            return -1;
+        }
+
+        memcpy(&buffer[offset], reply.payload, count);
+        offset += count;
+    }
+
+    return 0;
+}
+
+static int verify_image(session* const s, const uint8_t* const image,
+                        const uint16_t address, const uint16_t size) {
+    static uint8_t memory[MEMORY_SIZE];
+    if (read_memory(s, memory, address, size) != 0) {
+        return -1;
+    }
+
+    for (uint16_t i = 0; i < size; ++i) {
+        if (memory[i] != image[i]) {
+            fprintf(stderr, "verify: %04x reads %02x, expected %02x\n",
+                    address + i, memory[i], image[i]);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// Dumped memory, at the same addresses as in the EEPROM.
+static uint8_t memory[MEMORY_SIZE];
+
+static void read_dumped(uint8_t* const buffer, const uint16_t address,
+                        const uint16_t size) {
+    memcpy(buffer, &memory[address], size);
+}
+
+static void write_stdout(const uint8_t* const data, const uint16_t size) {
+    (void)fwrite(data, 1, size, stdout);
+}
+
+static const dump_config stdout_dump = {
+    .read  = read_dumped,
+    .write = write_stdout,
+};
+
+// Same output as eeprom_programmer_dump().
+static int dump_memory(session* const s, const uint16_t address,
+                       const uint16_t size, const dump_format format) {
+    if (read_memory(s, &memory[address], address, size) != 0) {
+        return -1;
+    }
+
+    dump(&stdout_dump, address, size, format);
+
+    return 0;
+}
+
+static int write_and_verify(session* const s, const options* const opts) {
+    static uint8_t image[MEMORY_SIZE];
+    uint16_t size;
+    if (load_image(image, &size, opts->image_path, opts->address) != 0) {
+        return -1;
+    }
+
+    const double start = now();
+    if (write_image(s, image, opts->address, size) != 0) {
+        return -1;
+    }
+    const double elapsed = now() - start;
+
+    printf("Wrote %u bytes in %.2f s (%.0f bytes/s), %lu frames, %lu resent\n",
+           size, elapsed, size / elapsed, s->frames, s->resends);
+
+    if (opts->verify) {
+        if (verify_image(s, image, opts->address, size) != 0) {
+            return -1;
+        }
+        printf("Verified\n");
+    }
+
+    return 0;
+}
+
+// Every session ends with FINISH, which the bootloader takes as the signal to
+// restart the computer. Verifying comes before it, while the bootloader still
+// holds the bus.
+static int run(session* const s, const options* const opts) {
+    s->frames  = 0;
+    s->resends = 0;
+
+    if (send_command(s, PROGRAMMER_BEGIN) != 0) {
+        return -1;
+    }
+
+    const int result =
+        opts->dump_size > 0
+            ? dump_memory(s, opts->address, opts->dump_size, opts->format)
+            : write_and_verify(s, opts);
+    if (result != 0) {
+        return -1;
+    }
+
+    return send_command(s, PROGRAMMER_FINISH);
+}
+
+static bool is_same_file(const struct stat* const a,
+                         const struct stat* const b) {
+    return a->st_mtim.tv_sec == b->st_mtim.tv_sec &&
+           a->st_mtim.tv_nsec == b->st_mtim.tv_nsec &&
+           a->st_size == b->st_size;
+}
+
+// Writes the image again each time it changes, on the port that is already
+// open, so the Nano isn't reset and the reset delay is only paid once. A
+// change is picked up once the file stayed the same for a whole interval, so
+// that a half-written image isn't sent. Runs until interrupted.
+static void watch(session* const s, const options* const opts) {
+    struct stat written = {};
+    (void)stat(opts->image_path, &written);
+    struct stat seen = written;
+
+    for (;;) {
+        (void)fflush(stdout);
+        (void)usleep(WATCH_INTERVAL_US);
+
+        // Briefly missing while an editor replaces it.
+        struct stat current;
+        if (stat(opts->image_path, &current) != 0) {
+            continue;
+        }
+
+        const bool is_settled = is_same_file(&current, &seen);
+        seen                  = current;
+        if (!is_settled || is_same_file(&current, &written)) {
+            continue;
+        }
+
+        written = current;
+        if (run(s, opts) != 0) {
+            fprintf(stderr, "%s: write failed, waiting for a change\n",
+                    opts->image_path);
+        }
+    }
+}
+
+int programmer_cli_main(int argc, char* argv[]) {
+    options opts;
+    if (parse_options(&opts, argc, argv) != 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    session s = {};
+    programmer_parser_reset(&s.parser);
+
+    pid_t device = -1;
+    if (opts.simulate) {
+        const simulated_device_options device_opts = {
+            .corrupt_percent = opts.corrupt_percent,
+            .write_cycle_us  = WRITE_CYCLE_US,
+        };
+        s.fd = simulated_device_start(&device_opts, &device);
+    } else {
+        s.fd = serial_port_open(opts.port, opts.baud_rate);
+
+        // Opening the port resets the Nano.
+        (void)usleep(RESET_DELAY_US);
+    }
+    if (s.fd < 0) {
+        return EXIT_FAILURE;
+    }
+
+    const int result = run(&s, &opts);
+    if (opts.watch) {
+        watch(&s, &opts);
+    }
+
+    (void)close(s.fd);
+    if (device > 0 && simulated_device_stop(device) != 0) {
+        return EXIT_FAILURE;
+    }
+
+    return result == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,105 @@
+#include "serial-port.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <termios.h>
+#include <unistd.h>
+
+static speed_t to_speed(const unsigned long baud_rate) {
+    switch (baud_rate) {
+        case 9600:
+            return B9600;
+        case 19200:
+            return B19200;
+        case 38400:
+            return B38400;
+        case 57600:
+            return B57600;
+        case 115200:
+            return B115200;
+        default:
+            return B0;
+    }
+}
+
+int serial_port_open(const char* const path, const unsigned long baud_rate) {
+    const speed_t speed = to_speed(baud_rate);
+    if (speed == B0) {
+        fprintf(stderr, "%s: unsupported baud rate %lu\n", path, baud_rate);
+        return -1;
+    }
+
+    const int fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+
+    struct termios tty;
+    if (tcgetattr(fd, &tty) != 0) {
+        perror(path);
+        (void)close(fd);
+        return -1;
+    }
+
+    cfmakeraw(&tty);
+    tty.c_cflag |= CLOCAL | CREAD;
+    tty.c_cc[VMIN]  = 0;
+    tty.c_cc[VTIME] = 0;
+    (void)cfsetispeed(&tty, speed);
+    (void)cfsetospeed(&tty, speed);
+
+    if (tcsetattr(fd, TCSANOW, &tty) != 0) {
+        perror(path);
+        (void)close(fd);
+        return -1;
+    }
+    (void)tcflush(fd, TCIOFLUSH);
+
+    return fd;
+}
+
+int serial_port_read(const int fd, uint8_t* const byte,
+                     const int timeout_ms) {
+    struct pollfd pfd = {
+        .fd      = fd,
+        .events  = POLLIN,
+        .revents = 0,
+    };
+
+    const int ready = poll(&pfd, 1, timeout_ms);
+    if (ready < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    if (ready == 0) {
+        return 0;
+    }
+
+    const ssize_t size = read(fd, byte, 1);
+    if (size < 0) {
+        return errno == EINTR || errno == EAGAIN ? 0 : -1;
+    }
+
+    return size == 1 ? 1 : -1;
+}
+
+int serial_port_write(const int fd, const uint8_t* const data,
+                      const size_t size) {
+    size_t written = 0;
+    while (written < size) {
+        const ssize_t result = write(fd, &data[written], size - written);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        written += result;
+    }
+
+    return 0;
+}
@@ -0,0 +1,170 @@
+#include "simulated-device.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "programmer-cli.h"
+#include "programmer-protocol.h"
+#include "programmer-server.h"
+#include "serial-port.h"
+
+// AT28C64B.
+constexpr uint8_t PAGE_SIZE = 64;
+
+typedef struct {
+    uint8_t memory[MEMORY_SIZE];
+    int fd;
+    simulated_device_options options;
+
+    // End of the running write cycle.
+    uint64_t busy_until_us;
+
+    unsigned long pages_written;
+    unsigned long bytes_corrupted;
+} simulated_device;
+
+// Only one device per process.
+static simulated_device device;
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void wait_write_cycle(void) {
+    const uint64_t now = now_us();
+    if (now < device.busy_until_us) {
+        (void)usleep(device.busy_until_us - now);
+    }
+}
+
+// The chip ignores loads during the write cycle, so this waits first just like
+// eeprom_programmer_begin_write().
+static void begin_write(const uint16_t address, const uint8_t* const data,
+                        const uint8_t size) {
+    wait_write_cycle();
+
+    memcpy(&device.memory[address], data, size);
+    device.busy_until_us = now_us() + device.options.write_cycle_us;
+    ++device.pages_written;
+}
+
+static void read_memory(uint8_t* const buffer, const uint16_t address,
+                        const uint8_t size) {
+    memcpy(buffer, &device.memory[address], size);
+}
+
+static void send_reply(const uint8_t* const data, const uint8_t size) {
+    (void)serial_port_write(device.fd, data, size);
+}
+
+static const programmer_server_config config = {
+    .begin_write = begin_write,
+    .wait        = wait_write_cycle,
+    .read        = read_memory,
+    .send        = send_reply,
+    .memory_size = MEMORY_SIZE,
+    .page_size   = PAGE_SIZE,
+    .begin       = nullptr,
+    .finish      = nullptr,
+};
+
+static void run(void) {
+    // Erased.
+    memset(device.memory, 0xff, sizeof(device.memory));
+
+    programmer_server server;
+    programmer_server_init(&server, &config);
+
+    uint8_t buffer[256];
+    for (;;) {
+        struct pollfd pfd = {
+            .fd      = device.fd,
+            .events  = POLLIN,
+            .revents = 0,
+        };
+        if (poll(&pfd, 1, PROGRAMMER_PROTOCOL_IDLE_TIMEOUT_MS) == 0) {
+            programmer_server_idle(&server);
+            continue;
+        }
+
+        // Fails with EIO once the host closed its end.
+        const ssize_t size = read(device.fd, buffer, sizeof(buffer));
+        if (size <= 0) {
+            break;
+        }
+
+        for (ssize_t i = 0; i < size; ++i) {
+            uint8_t byte = buffer[i];
+            if ((unsigned int)(rand() % 100) < device.options.corrupt_percent) {
+                byte ^= 1 << (rand() % 8);
+                ++device.bytes_corrupted;
+            }
+            programmer_server_receive(&server, byte);
+        }
+    }
+
+    fprintf(stderr,
+            "simulated device: %lu page writes, %lu bytes corrupted\n",
+            device.pages_written, device.bytes_corrupted);
+}
+
+int simulated_device_start(const simulated_device_options* const options,
+                           pid_t* const pid) {
+    const int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("pty");
+        return -1;
+    }
+
+    // Opened before forking so that the device never sees the terminal
+    // without a host on the other end.
+    const int fd =
+        serial_port_open(ptsname(master), PROGRAMMER_PROTOCOL_BAUD_RATE);
+    if (fd < 0) {
+        (void)close(master);
+        return -1;
+    }
+
+    *pid = fork();
+    if (*pid < 0) {
+        perror("fork");
+        (void)close(fd);
+        (void)close(master);
+        return -1;
+    }
+
+    if (*pid == 0) {
+        (void)close(fd);
+
+        device.fd      = master;
+        device.options = *options;
+        run();
+
+        _exit(EXIT_SUCCESS);
+    }
+
+    (void)close(master);
+
+    return fd;
+}
+
+int simulated_device_stop(const pid_t pid) {
+    int status;
+    if (waitpid(pid, &status, 0) < 0) {
+        perror("waitpid");
+        return -1;
+    }
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS ? 0 : -1;
+}
@@ -0,0 +1,111 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unity.h>
+
+#include "programmer-cli.h"
+#include "programmer-protocol.h"
+#include "util.h"
+
+constexpr uint8_t SYNC_SPACING = 8;
+
+static const char IMAGE_TEMPLATE[] = "/tmp/programmer-cli-test-XXXXXX";
+static char image_path[sizeof(IMAGE_TEMPLATE)];
+
+// Runs the CLI with `args` in a child, so that every run starts from a fresh
+// getopt() and fresh statics. Returns its exit status, with what it printed in
+// `output`.
+static int run_cli(char* args[], const int arg_count, char* const output,
+                   const size_t size) {
+    int pipe_fds[2];
+    TEST_ASSERT_EQUAL_INT(0, pipe(pipe_fds));
+
+    // Or the child would print what is still buffered too.
+    (void)fflush(stdout);
+    const pid_t pid = fork();
+    TEST_ASSERT_NOT_EQUAL(-1, pid);
+
+    if (pid == 0) {
+        (void)close(pipe_fds[0]);
+        (void)dup2(pipe_fds[1], STDOUT_FILENO);
+        (void)close(pipe_fds[1]);
+
+        const int result = programmer_cli_main(arg_count, args);
+        (void)fflush(stdout);
+        _exit(result);
+    }
+
+    (void)close(pipe_fds[1]);
+    size_t length = 0;
+    for (;;) {
+        const ssize_t count =
+            read(pipe_fds[0], &output[length], size - 1 - length);
+        if (count <= 0) {
+            break;
+        }
+        length += count;
+    }
+    output[length] = '\0';
+    (void)close(pipe_fds[0]);
+
+    int status;
+    TEST_ASSERT_EQUAL_INT(pid, waitpid(pid, &status, 0));
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static void test_write_and_verify(void) {
+    char* args[] = {(char*)"programmer-cli", (char*)"-s", (char*)"-v",
+                    image_path};
+
+    char output[256];
+    TEST_ASSERT_EQUAL_INT(
+        EXIT_SUCCESS, run_cli(args, ARRAY_SIZE(args), output, sizeof(output)));
+    TEST_ASSERT_NOT_NULL(strstr(output, ", 0 resent"));
+    TEST_ASSERT_NOT_NULL(strstr(output, "Verified"));
+}
+
+// Each resend follows the rest of a corrupted frame, whose sync bytes must not
+// start a frame that swallows the resend.
+static void test_write_and_verify_corrupted(void) {
+    char* args[] = {(char*)"programmer-cli", (char*)"-s", (char*)"-e",
+                    (char*)"1", (char*)"-v", image_path};
+
+    char output[256];
+    TEST_ASSERT_EQUAL_INT(
+        EXIT_SUCCESS, run_cli(args, ARRAY_SIZE(args), output, sizeof(output)));
+    TEST_ASSERT_NULL(strstr(output, ", 0 resent"));
+    TEST_ASSERT_NOT_NULL(strstr(output, "Verified"));
+}
+
+// A full chip of random bytes with a sync byte every few, as in the payloads
+// that used to throw the device out of step after a corrupted frame.
+void setUp(void) {
+    strcpy(image_path, IMAGE_TEMPLATE);
+    const int fd = mkstemp(image_path);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+
+    uint8_t image[MEMORY_SIZE];
+    srand(1);
+    for (uint16_t i = 0; i < MEMORY_SIZE; ++i) {
+        image[i] = i % SYNC_SPACING == 0 ? PROGRAMMER_PROTOCOL_SYNC : rand();
+    }
+
+    TEST_ASSERT_EQUAL(sizeof(image), write(fd, image, sizeof(image)));
+    (void)close(fd);
+}
+
+void tearDown(void) {
+    (void)unlink(image_path);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_write_and_verify);
+    RUN_TEST(test_write_and_verify_corrupted);
+
+    return UNITY_END();
+}
@@ -0,0 +1,92 @@
+#ifndef AT28C64B_MODEL_H
+#define AT28C64B_MODEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "arduino-native.h"
+#include "hc595-model.h"
+
+// AT28C64B. (AT28C64B Datasheet)
+#define AT28C64B_MODEL_SIZE      8192
+#define AT28C64B_MODEL_PAGE_SIZE 64
+
+// A page write ends once no byte was loaded for tBLC. (Section 4.3)
+#define AT28C64B_MODEL_LOAD_WINDOW_NS 150000
+
+// Max tWC. (Section 16)
+#define AT28C64B_MODEL_MAX_WRITE_CYCLE_NS 10000000
+
+// For chip_enable_output when CE is tied low.
+#define AT28C64B_MODEL_CE_TIED_LOW 0xff
+
+typedef struct {
+    // A0-A12 on outputs 0-12 of the chain, and CE on `chip_enable_output`.
+    const hc595_model* address_source;
+    uint8_t chip_enable_output;
+
+    uint8_t write_en_pin;
+    uint8_t output_en_pin;
+    uint8_t data_pins[8];  // I/O0-I/O7.
+
+    // How long write cycles take, at most
+    // AT28C64B_MODEL_MAX_WRITE_CYCLE_NS.
+    uint32_t write_cycle_ns;
+} at28c64b_model_config;
+
+typedef enum {
+    AT28C64B_MODEL_IDLE,
+    AT28C64B_MODEL_LOADING,  // Within the load window of the last byte.
+    AT28C64B_MODEL_WRITING,  // In the write cycle.
+} at28c64b_model_state;
+
+typedef struct {
+    uint32_t bytes_loaded;
+    uint32_t pages_written;
+    uint32_t reads;
+    uint32_t polls;  // Reads while busy.
+    uint64_t write_cycle_ns;
+
+    // Misuse that the real chip doesn't forgive. Each one loses data or
+    // reads garbage.
+    uint32_t writes_while_busy;   // Ignored during a write cycle.
+    uint32_t writes_with_output;  // Inhibited by OE being low.
+    uint32_t page_crossings;      // Not in the page of the first byte.
+    uint32_t bus_contentions;     // MCU and chip both driving I/O.
+} at28c64b_model_stats;
+
+typedef struct {
+    at28c64b_model_config config;
+    arduino_native_device device;
+
+    uint8_t memory[AT28C64B_MODEL_SIZE];
+
+    at28c64b_model_state state;
+    uint8_t page[AT28C64B_MODEL_PAGE_SIZE];
+    uint64_t page_loaded;  // Bit per byte of `page`.
+    uint16_t page_address;
+    uint64_t load_end_ns;
+    uint64_t write_end_ns;
+
+    uint16_t address;  // Latched on the falling edge of WE.
+    uint8_t last_data;
+    bool toggle;  // I/O6 while busy.
+
+    bool write_en_level;
+    bool output_en_level;
+    bool chip_en_level;
+    bool contending;
+
+    at28c64b_model_stats stats;
+} at28c64b_model;
+
+// Resets the chip to erased and attaches it to the shim.
+void at28c64b_model_attach(at28c64b_model* const model,
+                           const at28c64b_model_config* const config);
+
+// Finishes whatever write is in progress, e.g. before comparing `memory`.
+void at28c64b_model_settle(at28c64b_model* const model);
+
+uint32_t at28c64b_model_violations(const at28c64b_model* const model);
+
+#endif  // AT28C64B_MODEL_H
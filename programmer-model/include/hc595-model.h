@@ -0,0 +1,32 @@
+#ifndef HC595_MODEL_H
+#define HC595_MODEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "arduino-native.h"
+
+// A chain of 74HC595s fed by SPI: SER on MOSI, SRCLK on SCK and RCLK on
+// `latch_pin`. Output i of the chain is bit i of the last 16 or 32 bits
+// shifted in, MSB first. OE is tied low and SRCLR high.
+typedef struct {
+    uint8_t latch_pin;
+    uint8_t chip_count;  // At most 4.
+} hc595_model_config;
+
+typedef struct {
+    hc595_model_config config;
+    arduino_native_device device;
+
+    uint32_t shift;
+    uint32_t output;
+    bool latch_level;
+
+    uint32_t latches;
+} hc595_model;
+
+// Resets the chain and attaches it to the shim.
+void hc595_model_attach(hc595_model* const model,
+                        const hc595_model_config* const config);
+
+#endif  // HC595_MODEL_H
@@ -0,0 +1,219 @@
+#include "at28c64b-model.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "arduino-native.h"
+#include "hc595-model.h"
+#include "pin-map.h"
+#include "util.h"
+
+// Data polling reads the complement of the last byte loaded on I/O7 and a
+// bit that toggles with every read on I/O6. (Sections 4.5 and 4.6, AT28C64B
+// Datasheet)
+constexpr uint8_t DATA_POLLING_BIT = 7;
+constexpr uint8_t TOGGLE_BIT       = 6;
+
+// Control inputs that nothing drives read as high, as if pulled up.
+constexpr bool FLOATING_CONTROL_LEVEL = true;
+
+// Moves the chip along to `now`.
+static void update(at28c64b_model* const model, const uint64_t now) {
+    if (model->state == AT28C64B_MODEL_LOADING && now >= model->load_end_ns) {
+        model->state        = AT28C64B_MODEL_WRITING;
+        model->write_end_ns =
+            model->load_end_ns + model->config.write_cycle_ns;
+    }
+
+    if (model->state == AT28C64B_MODEL_WRITING && now >= model->write_end_ns) {
+        for (uint8_t i = 0; i < AT28C64B_MODEL_PAGE_SIZE; ++i) {
+            if ((model->page_loaded & (1ULL << i)) != 0) {
+                model->memory[model->page_address + i] = model->page[i];
+            }
+        }
+
+        model->state = AT28C64B_MODEL_IDLE;
+        ++model->stats.pages_written;
+        model->stats.write_cycle_ns += model->config.write_cycle_ns;
+    }
+}
+
+static uint16_t address_lines(const at28c64b_model* const model) {
+    return model->config.address_source->output % AT28C64B_MODEL_SIZE;
+}
+
+static bool chip_enable_level(const at28c64b_model* const model) {
+    const uint8_t output = model->config.chip_enable_output;
+
+    return output != AT28C64B_MODEL_CE_TIED_LOW &&
+           (model->config.address_source->output & BIT(output)) != 0;
+}
+
+static bool is_mcu_output(const uint8_t pin) {
+    const pin_map_location location = pin_map_locate(pin);
+
+    return (pin_map_mock_read(location.port, PIN_MAP_DDR) &
+            BIT(location.bit)) != 0;
+}
+
+static bool mcu_drives_data(const at28c64b_model* const model) {
+    for (uint8_t i = 0; i < ARRAY_SIZE(model->config.data_pins); ++i) {
+        if (is_mcu_output(model->config.data_pins[i])) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static uint8_t mcu_data(const at28c64b_model* const model) {
+    uint8_t data = 0;
+    for (uint8_t i = 0; i < ARRAY_SIZE(model->config.data_pins); ++i) {
+        if (arduino_native_pin_output(model->config.data_pins[i], false)) {
+            data |= BIT(i);
+        }
+    }
+
+    return data;
+}
+
+// Called on the rising edge of WE, which latches the data.
+static void load_byte(at28c64b_model* const model, const uint64_t now) {
+    if (model->state == AT28C64B_MODEL_WRITING) {
+        ++model->stats.writes_while_busy;
+        return;
+    }
+
+    const uint8_t offset        = model->address % AT28C64B_MODEL_PAGE_SIZE;
+    const uint16_t page_address = model->address - offset;
+    if (model->state == AT28C64B_MODEL_IDLE) {
+        model->state        = AT28C64B_MODEL_LOADING;
+        model->page_address = page_address;
+        model->page_loaded  = 0;
+    } else if (page_address != model->page_address) {
+        ++model->stats.page_crossings;
+        return;
+    }
+
+    model->page_loaded |= 1ULL << offset;
+
+    const uint8_t data  = mcu_data(model);
+    model->page[offset] = data;
+    model->last_data    = data;
+    model->load_end_ns  = now + AT28C64B_MODEL_LOAD_WINDOW_NS;
+    ++model->stats.bytes_loaded;
+}
+
+static void after_write(const pin_map_port port, const pin_map_register reg,
+                        void* const context) {
+    (void)port;
+    (void)reg;
+    at28c64b_model* const model = (at28c64b_model*)context;
+    const uint64_t now          = arduino_native_now_ns();
+    update(model, now);
+
+    const bool write_en  = arduino_native_pin_output(
+        model->config.write_en_pin, FLOATING_CONTROL_LEVEL);
+    const bool output_en = arduino_native_pin_output(
+        model->config.output_en_pin, FLOATING_CONTROL_LEVEL);
+    const bool chip_en   = chip_enable_level(model);
+
+    // Each new read toggles I/O6 while busy.
+    const bool was_reading = !model->chip_en_level && !model->output_en_level;
+    const bool reading     = !chip_en && !output_en;
+    if (reading && !was_reading && model->state != AT28C64B_MODEL_IDLE) {
+        model->toggle = !model->toggle;
+    }
+
+    // The address is latched on the falling edge of WE and the data on the
+    // rising edge, while CE is low. A low OE inhibits writes. (Section 4.2)
+    if (!chip_en && !write_en && model->write_en_level) {
+        model->address = address_lines(model);
+    }
+    if (!chip_en && write_en && !model->write_en_level) {
+        if (output_en) {
+            load_byte(model, now);
+        } else {
+            ++model->stats.writes_with_output;
+        }
+    }
+
+    // Counted once each time both sides start driving.
+    const bool contending = reading && write_en && mcu_drives_data(model);
+    if (contending && !model->contending) {
+        ++model->stats.bus_contentions;
+    }
+
+    model->write_en_level  = write_en;
+    model->output_en_level = output_en;
+    model->chip_en_level   = chip_en;
+    model->contending      = contending;
+}
+
+static void before_read(const pin_map_port port, void* const context) {
+    at28c64b_model* const model = (at28c64b_model*)context;
+    update(model, arduino_native_now_ns());
+
+    // The 595s only change on writes, so CE is as of the last one.
+    const uint8_t* const pins = model->config.data_pins;
+    if (model->chip_en_level || model->output_en_level ||
+        !model->write_en_level) {
+        return;
+    }
+
+    uint8_t data = model->memory[address_lines(model)];
+
+    // Counted once per read of the bus, on the port of I/O7.
+    const pin_map_port io7_port = pin_map_locate(pins[DATA_POLLING_BIT]).port;
+    if (port == io7_port) {
+        ++model->stats.reads;
+    }
+
+    // Reads as busy from the first byte loaded, so that polling right after
+    // the last one doesn't see the old contents.
+    if (model->state != AT28C64B_MODEL_IDLE) {
+        data &= ~(BIT(DATA_POLLING_BIT) | BIT(TOGGLE_BIT));
+        data |= ~model->last_data & BIT(DATA_POLLING_BIT);
+        data |= model->toggle ? BIT(TOGGLE_BIT) : 0;
+        if (port == io7_port) {
+            ++model->stats.polls;
+        }
+    }
+
+    for (uint8_t i = 0; i < ARRAY_SIZE(model->config.data_pins); ++i) {
+        arduino_native_drive_pin(pins[i], (data & BIT(i)) != 0);
+    }
+}
+
+void at28c64b_model_attach(at28c64b_model* const model,
+                           const at28c64b_model_config* const config) {
+    memset(model, 0, sizeof(*model));
+    model->config = *config;
+    model->device = {
+        .spi_transfer = nullptr,
+        .before_read  = before_read,
+        .after_write  = after_write,
+        .context      = model,
+    };
+
+    // Shipped erased.
+    memset(model->memory, 0xff, sizeof(model->memory));
+    model->state           = AT28C64B_MODEL_IDLE;
+    model->write_en_level  = FLOATING_CONTROL_LEVEL;
+    model->output_en_level = FLOATING_CONTROL_LEVEL;
+    model->chip_en_level   = chip_enable_level(model);
+
+    arduino_native_attach(&model->device);
+}
+
+void at28c64b_model_settle(at28c64b_model* const model) {
+    update(model, UINT64_MAX);
+}
+
+uint32_t at28c64b_model_violations(const at28c64b_model* const model) {
+    const at28c64b_model_stats* const stats = &model->stats;
+
+    return stats->writes_while_busy + stats->writes_with_output +
+           stats->page_crossings + stats->bus_contentions;
+}
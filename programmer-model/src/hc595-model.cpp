@@ -0,0 +1,51 @@
+#include "hc595-model.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "arduino-native.h"
+#include "util.h"
+
+static void spi_transfer(const uint8_t data, void* const context) {
+    hc595_model* const model = (hc595_model*)context;
+    model->shift             = model->shift << 8 | data;
+}
+
+// The storage register takes the shift register on the rising edge of RCLK.
+// (Section 8.4, SN74HC595 Datasheet)
+static void after_write(const pin_map_port port, const pin_map_register reg,
+                        void* const context) {
+    (void)port;
+    (void)reg;
+    hc595_model* const model = (hc595_model*)context;
+
+    const bool level =
+        arduino_native_pin_output(model->config.latch_pin, false);
+    if (level && !model->latch_level) {
+        const uint8_t bits  = 8 * model->config.chip_count;
+        const uint32_t mask = bits < 32 ? BIT(bits) - 1 : UINT32_MAX;
+        model->output       = model->shift & mask;
+        ++model->latches;
+    }
+    model->latch_level = level;
+}
+
+void hc595_model_attach(hc595_model* const model,
+                        const hc595_model_config* const config) {
+    *model = {
+        .config = *config,
+        .device =
+            {
+                .spi_transfer = spi_transfer,
+                .before_read  = nullptr,
+                .after_write  = after_write,
+                .context      = model,
+            },
+        .shift       = 0,
+        .output      = 0,
+        .latch_level = false,
+        .latches     = 0,
+    };
+
+    arduino_native_attach(&model->device);
+}
@@ -0,0 +1,156 @@
+#include <Arduino.h>
+#include <HardwareSerial.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "arduino-native.h"
+#include "at28c64b-model.h"
+#include "eeprom-programmer.h"
+#include "hc595-model.h"
+
+// Runs the setup() of the sketch this is built with against models of the
+// programmer board, on the virtual clock. The sketch's serial output goes to
+// stdout and the report to stderr. Fails when the sketch misused the chip.
+
+typedef struct {
+    uint32_t write_cycle_ns;
+    unsigned int runs;
+} options;
+
+static void usage(const char* const name) {
+    fprintf(stderr,
+            "Usage: %s [-c us] [-n runs]\n"
+            "\n"
+            "  -c us    Write cycle time of the EEPROM. Defaults to the\n"
+            "           maximum of %u us.\n"
+            "  -n runs  Times to reset the Nano and run the sketch against\n"
+            "           the same EEPROM. Defaults to 1.\n",
+            name, AT28C64B_MODEL_MAX_WRITE_CYCLE_NS / 1000);
+}
+
+static int parse_options(options* const opts, const int argc,
+                         char* const argv[]) {
+    *opts = {
+        .write_cycle_ns = AT28C64B_MODEL_MAX_WRITE_CYCLE_NS,
+        .runs           = 1,
+    };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:n:")) != -1) {
+        switch (opt) {
+            case 'c': {
+                const unsigned long us = strtoul(optarg, nullptr, 0);
+                if (us == 0 || us > AT28C64B_MODEL_MAX_WRITE_CYCLE_NS / 1000) {
+                    return -1;
+                }
+                opts->write_cycle_ns = us * 1000;
+                break;
+            }
+            case 'n':
+                opts->runs = strtoul(optarg, nullptr, 0);
+                if (opts->runs == 0) {
+                    return -1;
+                }
+                break;
+            default:
+                return -1;
+        }
+    }
+
+    return optind == argc ? 0 : -1;
+}
+
+static void print_report(const unsigned int run, const uint64_t elapsed_ns,
+                         const at28c64b_model_stats* const before,
+                         const at28c64b_model* const eeproms) {
+    fprintf(stderr, "run %u: %.3f s\n", run, elapsed_ns / 1e9);
+    for (uint8_t chip = 0; chip < EEPROM_PROGRAMMER_CHIP_COUNT; ++chip) {
+        const at28c64b_model_stats* const after = &eeproms[chip].stats;
+        fprintf(stderr,
+                "  chip %u: %" PRIu32 " pages written, %" PRIu32
+                " bytes loaded, %" PRIu32 " reads, %" PRIu32 " polls\n",
+                chip, after->pages_written - before[chip].pages_written,
+                after->bytes_loaded - before[chip].bytes_loaded,
+                after->reads - before[chip].reads,
+                after->polls - before[chip].polls);
+    }
+}
+
+static void print_violations(const uint8_t chip,
+                             const at28c64b_model_stats* const stats) {
+    fprintf(stderr,
+            "chip %u violations: %" PRIu32 " writes while busy, %" PRIu32
+            " writes with OE low, %" PRIu32 " page crossings, %" PRIu32
+            " bus contentions\n",
+            chip, stats->writes_while_busy, stats->writes_with_output,
+            stats->page_crossings, stats->bus_contentions);
+}
+
+int main(int argc, char* argv[]) {
+    options opts;
+    if (parse_options(&opts, argc, argv) != 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    arduino_native_reset();
+
+    static hc595_model address_shifter;
+    const hc595_model_config shifter_config = {
+        .latch_pin  = EEPROM_PROGRAMMER_LATCH_PIN,
+        .chip_count = 2,
+    };
+    hc595_model_attach(&address_shifter, &shifter_config);
+
+    // Sharing the bus, each with its CE on an output of the chain.
+    static at28c64b_model eeproms[EEPROM_PROGRAMMER_CHIP_COUNT];
+    for (uint8_t chip = 0; chip < EEPROM_PROGRAMMER_CHIP_COUNT; ++chip) {
+        const at28c64b_model_config eeprom_config = {
+            .address_source     = &address_shifter,
+            .chip_enable_output =
+                (uint8_t)(EEPROM_PROGRAMMER_CHIP_ENABLE_POS + chip),
+            .write_en_pin       = EEPROM_PROGRAMMER_WRITE_EN_PIN,
+            .output_en_pin      = EEPROM_PROGRAMMER_OUTPUT_EN_PIN,
+            .data_pins          = EEPROM_PROGRAMMER_DATA_PINS,
+            .write_cycle_ns     = opts.write_cycle_ns,
+        };
+        at28c64b_model_attach(&eeproms[chip], &eeprom_config);
+    }
+
+    for (unsigned int run = 1; run <= opts.runs; ++run) {
+        at28c64b_model_stats before[EEPROM_PROGRAMMER_CHIP_COUNT];
+        for (uint8_t chip = 0; chip < EEPROM_PROGRAMMER_CHIP_COUNT; ++chip) {
+            before[chip] = eeproms[chip].stats;
+        }
+        const uint64_t start = arduino_native_now_ns();
+
+        setup();
+        Serial.flush();
+
+        print_report(run, arduino_native_now_ns() - start, before, eeproms);
+    }
+
+    bool failed = false;
+    for (uint8_t chip = 0; chip < EEPROM_PROGRAMMER_CHIP_COUNT; ++chip) {
+        if (at28c64b_model_violations(&eeproms[chip]) != 0) {
+            print_violations(chip, &eeproms[chip].stats);
+            failed = true;
+        }
+    }
+
+    // More than one chip driving the bus at once.
+    const uint32_t conflicts = arduino_native_bus_conflicts();
+    if (conflicts != 0) {
+        fprintf(stderr, "%" PRIu32 " bus conflicts\n", conflicts);
+        failed = true;
+    }
+
+    if (failed) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,50 @@
+#include <Arduino.h>
+#include <HardwareSerial.h>
+#include <stdint.h>
+
+#include "eeprom-programmer.h"
+#include "programmer-protocol.h"
+#include "programmer-server.h"
+
+// Images are streamed from the host with programmer-cli instead of being
+// built into the firmware.
+
+static void read(uint8_t* const buffer, const uint16_t address,
+                 const uint8_t size) {
+    eeprom_programmer_read(buffer, address, size);
+}
+
+static void send(const uint8_t* const data, const uint8_t size) {
+    (void)Serial.write(data, size);
+}
+
+static const programmer_server_config config = {
+    .begin_write = eeprom_programmer_begin_write,
+    .wait        = eeprom_programmer_wait,
+    .read        = read,
+    .send        = send,
+    .memory_size = EEPROM_SIZE,
+    .page_size   = EEPROM_PAGE_SIZE,
+    .begin       = nullptr,
+    .finish      = nullptr,
+};
+
+static programmer_server server;
+
+void setup(void) {
+    Serial.begin(PROGRAMMER_PROTOCOL_BAUD_RATE);
+    eeprom_programmer_init();
+    programmer_server_init(&server, &config);
+}
+
+void loop(void) {
+    static unsigned long last_receive_ms;
+
+    if (Serial.available() > 0) {
+        programmer_server_receive(&server, Serial.read());
+        last_receive_ms = millis();
+    } else if (millis() - last_receive_ms >=
+               PROGRAMMER_PROTOCOL_IDLE_TIMEOUT_MS) {
+        programmer_server_idle(&server);
+    }
+}
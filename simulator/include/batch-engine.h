@@ -0,0 +1,24 @@
+#ifndef BATCH_ENGINE_H
+#define BATCH_ENGINE_H
+
+#include <stdint.h>
+
+#include "sap.h"
+
+// Machines stepped together: one per byte of a 128-bit vector, or of a
+// 256-bit one where AVX2 is available.
+#define BATCH_ENGINE_LANES      16
+#define BATCH_ENGINE_AVX2_LANES 32
+
+// Runs `count` machines for up to `max_instructions` instructions each, a
+// batch at a time. Every register and RAM address is a vector with a lane per
+// machine, so each step executes one instruction on the whole batch. Lanes
+// that took another branch or halted are masked out. Returns the total number
+// of instructions executed.
+//
+// Output handlers aren't called; `out` and `outputs` are up to date at the
+// end.
+uint64_t batch_engine_run(sap_machine* const machines, const uint32_t count,
+                          const uint64_t max_instructions);
+
+#endif  // BATCH_ENGINE_H
@@ -0,0 +1,38 @@
+#ifndef FAST_FORWARD_H
+#define FAST_FORWARD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sap.h"
+
+// Instructions stepped while looking for a repeat before giving up.
+#define FAST_FORWARD_MAX_STEPS (1 << 22)
+
+// How the machine repeats once it settles into a loop.
+typedef struct {
+    bool found;
+
+    // Instruction count at which the repeat was detected. From there on the
+    // machine cycles through the same states.
+    uint64_t detected_at;
+
+    uint64_t instructions;
+    uint64_t cycles;
+    uint64_t outputs;  // Period of the OUT sequence.
+
+    uint64_t periods_skipped;
+} fast_forward_period;
+
+// Steps the machine until its state repeats at a backward jump, then skips as
+// many whole periods as fit in `max_instructions` without executing them. The
+// state is unchanged by a skip, only the counters move on. OUT values of the
+// skipped periods aren't reported to the output handler.
+//
+// Returns the instructions executed or skipped. The rest of the budget can be
+// run with any engine.
+uint64_t fast_forward(sap_machine* const machine,
+                      const uint64_t max_instructions,
+                      fast_forward_period* const period);
+
+#endif  // FAST_FORWARD_H
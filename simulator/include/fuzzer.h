@@ -0,0 +1,49 @@
+#ifndef FUZZER_H
+#define FUZZER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "microcode-engine.h"
+#include "microcode.h"
+#include "program.h"
+#include "sap.h"
+
+typedef struct {
+    uint64_t program_count;
+    uint64_t instruction_count;  // Per program.
+    uint64_t seed;
+    unsigned int thread_count;
+
+    // The set the microcode engine was built from, which decides how many
+    // cycles each instruction should take.
+    microcode_set set;
+} fuzzer_options;
+
+typedef struct {
+    uint64_t programs_run;
+
+    // The divergence with the lowest program index, so the same for any
+    // number of threads.
+    bool found;
+    uint64_t program_index;
+    uint8_t image[MEMORY_SIZE];
+
+    // Smallest change of `image` found that still diverges, the instruction
+    // after which it first does and the state of both engines there.
+    uint8_t minimized[MEMORY_SIZE];
+    uint64_t instruction;
+    sap_machine reference;
+    sap_machine microcoded;
+} fuzzer_result;
+
+// Runs random RAM images on the ISA engine and the microcode engine in
+// lockstep and compares the machines after every instruction. The microcode
+// engine's cycles are checked against what each instruction should take in
+// `set`. Image i only depends on `seed` and i, so any of them can be run again
+// on its own.
+void fuzzer_run(const microcode_engine* const engine,
+                const fuzzer_options* const options,
+                fuzzer_result* const result);
+
+#endif  // FUZZER_H
@@ -0,0 +1,14 @@
+#ifndef ISA_ENGINE_H
+#define ISA_ENGINE_H
+
+#include <stdint.h>
+
+#include "sap.h"
+
+// Instruction-level interpreter. Executes up to `max_instructions`
+// instructions or until the machine halts and returns the number of
+// instructions executed.
+uint64_t isa_engine_run(sap_machine* const machine,
+                        const uint64_t max_instructions);
+
+#endif  // ISA_ENGINE_H
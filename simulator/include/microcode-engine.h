@@ -0,0 +1,34 @@
+#ifndef MICROCODE_ENGINE_H
+#define MICROCODE_ENGINE_H
+
+#include <stdint.h>
+
+#include "microcode.h"
+#include "op-code.h"
+#include "sap.h"
+#include "util.h"
+
+// Control words reassembled from all the microcode EEPROMs, indexed the same
+// way as their address lines. Small enough to stay in L1.
+typedef struct {
+    uint32_t control_words[POW2(FLAG_COUNT)][STEP_COUNT][OP_CODE_COUNT];
+
+    // EEPROM address of the first control word that enables more than one
+    // bus driver. Set when microcode_engine_init() fails.
+    uint16_t conflict_address;
+} microcode_engine;
+
+// Returns -1 if any control word has bus contention.
+int microcode_engine_init(microcode_engine* const engine,
+                          const uint8_t image[MICROCODE_IMAGE_SIZE]);
+
+// Clocks the machine one microstep at a time, ending instructions early on SR.
+// Cycles are counted as the hardware takes them, so they come out lower than
+// on the ISA-level engines. Executes up to
+// `max_instructions` complete instructions or until the machine halts and
+// returns the number of instructions executed.
+uint64_t microcode_engine_run(const microcode_engine* const engine,
+                              sap_machine* const machine,
+                              const uint64_t max_instructions);
+
+#endif  // MICROCODE_ENGINE_H
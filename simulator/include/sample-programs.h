@@ -0,0 +1,19 @@
+#ifndef SAMPLE_PROGRAMS_H
+#define SAMPLE_PROGRAMS_H
+
+#include <stdint.h>
+
+#include "program.h"
+
+// The same task written twice, to see what JNC, JNZ and ADO save.
+typedef struct {
+    const char* name;
+    const uint8_t* before;  // Without them.
+    const uint8_t* after;
+} sample_program;
+
+#define SAMPLE_PROGRAM_COUNT 2
+
+extern const sample_program sample_programs[SAMPLE_PROGRAM_COUNT];
+
+#endif  // SAMPLE_PROGRAMS_H
@@ -0,0 +1,70 @@
+#ifndef SAP_H
+#define SAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "microcode.h"
+#include "program.h"
+#include "util.h"
+
+// The ISA-level engines count cycles as on a machine without the step counter
+// reset: every instruction runs through all the steps, whether or not its
+// microcode uses them. The microcode engine counts the cycles actually taken.
+#define SAP_CYCLES_PER_INSTRUCTION STEP_COUNT
+
+// HLT stops the clock right after the fetch cycle.
+#define SAP_HALT_CYCLES ARRAY_SIZE(fetch_cycle)
+
+#define SAP_ADDRESS_MASK MASK(3, 0)
+
+// Layout matches the flag address lines of the microcode EEPROMs.
+typedef enum {
+    SAP_CARRY = BIT(CARRY_FLAG),
+    SAP_ZERO  = BIT(ZERO_FLAG),
+} sap_flag;
+
+struct sap_machine;
+
+// Called every time the output register is loaded.
+typedef void (*sap_output_handler)(const struct sap_machine* machine,
+                                   void* context);
+
+typedef struct sap_machine {
+    uint8_t a;
+    uint8_t b;
+    uint8_t pc;
+    uint8_t flags;
+    uint8_t out;
+    bool halted;
+    uint8_t ram[MEMORY_SIZE];
+
+    // Only tracked by the microcode engine.
+    uint8_t ir;
+    uint8_t mar;
+    uint8_t step;
+
+    uint64_t instructions;
+    uint64_t cycles;
+    uint64_t outputs;
+
+    // Optional.
+    sap_output_handler on_output;
+    void* context;
+} sap_machine;
+
+void sap_reset(sap_machine* const machine, const uint8_t image[MEMORY_SIZE]);
+
+// Adder/subtractor shared by all engines. Subtraction is done as a + ~b + 1,
+// so carry is set when no borrow occurs.
+static inline uint8_t sap_alu(const uint8_t a, const uint8_t b,
+                              const bool subtract, uint8_t* const flags) {
+    const uint16_t sum = a + (uint8_t)(subtract ? ~b : b) + subtract;
+    const uint8_t result = sum & MASK(7, 0);
+
+    *flags = (sum > MASK(7, 0) ? SAP_CARRY : 0) | (result == 0 ? SAP_ZERO : 0);
+
+    return result;
+}
+
+#endif  // SAP_H
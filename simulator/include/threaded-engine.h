@@ -0,0 +1,14 @@
+#ifndef THREADED_ENGINE_H
+#define THREADED_ENGINE_H
+
+#include <stdint.h>
+
+#include "sap.h"
+
+// Pre-decodes RAM into a direct-threaded dispatch table, fusing common
+// instruction pairs into superinstructions. Entries are re-decoded whenever
+// STA writes to RAM. Same contract as isa_engine_run().
+uint64_t threaded_engine_run(sap_machine* const machine,
+                             const uint64_t max_instructions);
+
+#endif  // THREADED_ENGINE_H
@@ -0,0 +1,493 @@
+#include "batch-engine.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif  // __x86_64__
+
+#include "op-code.h"
+#include "program.h"
+#include "sap.h"
+#include "util.h"
+
+// Flags, as lane values.
+constexpr uint8_t CARRY = SAP_CARRY;
+constexpr uint8_t ZERO  = SAP_ZERO;
+
+// The per-lane counters are bytes, so they are added to the machines at
+// least this often.
+constexpr uint8_t STEPS_PER_FLUSH = UINT8_MAX;
+
+// Byte shuffles look up one of 16 entries per lane, which covers every RAM
+// address.
+constexpr uint8_t TABLE_SIZE = 16;
+static_assert(MEMORY_SIZE == TABLE_SIZE, "RAM must fit a shuffle table.");
+
+// Whether the baseline build has a byte shuffle for lookup(): SSSE3 on x86-64
+// and TBL on ARM. Without one, GCC shuffles a byte at a time.
+#if defined(__SSSE3__) || defined(__aarch64__)
+constexpr bool BASELINE_SHUFFLES = true;
+#else
+constexpr bool BASELINE_SHUFFLES = false;
+#endif  // __SSSE3__ || __aarch64__
+
+// RAM reads blend in the addresses whose bytes differ between lanes one by
+// one, up to this many. Past that, a blend tree on the address bits is
+// cheaper.
+constexpr uint8_t MAX_VARYING_ADDRESSES = 4;
+
+// A byte per machine, in vectors of one register. GCC only splits wider
+// vectors for arithmetic; comparisons and selects fall back to scalar code.
+template <uint8_t LANE_COUNT>
+struct vectors {
+    typedef uint8_t lanes __attribute__((vector_size(LANE_COUNT)));
+
+    // What comparisons of lanes give: every bit of a lane set or clear.
+    typedef int8_t mask __attribute__((vector_size(LANE_COUNT)));
+
+    // Bytes can't be shifted on their own, so shifts go through words and
+    // mask off what came in from the neighbouring byte.
+    typedef uint16_t words __attribute__((vector_size(LANE_COUNT)));
+
+    typedef uint8_t table __attribute__((vector_size(TABLE_SIZE)));
+
+    typedef struct {
+        lanes a;
+        lanes b;
+        lanes pc;
+        lanes flags;
+        lanes out;
+        mask halted;
+        lanes ram[MEMORY_SIZE];
+
+        // The RAM of the first lane, which all lanes share except at the
+        // addresses set in `varying`.
+        table shared_ram;
+        uint16_t varying;
+
+        // Since the last flush.
+        lanes executed;
+        lanes outputs;
+        mask halted_before;
+    } state;
+};
+
+// Inlined into each build of run_batch(), so that they use its instructions.
+// Results are passed back through pointers: a vector returned by value from a
+// function built without AVX would change the ABI.
+#define BATCH_ENGINE_INLINE __attribute__((always_inline)) static inline
+
+template <uint8_t LANE_COUNT>
+BATCH_ENGINE_INLINE bool any(
+    const typename vectors<LANE_COUNT>::mask& mask) {
+    uint64_t words[LANE_COUNT / sizeof(uint64_t)];
+    memcpy(words, &mask, sizeof(words));
+
+    uint64_t any = 0;
+    for (uint8_t i = 0; i < ARRAY_SIZE(words); ++i) {
+        any |= words[i];
+    }
+
+    return any != 0;
+}
+
+#if defined(__x86_64__)
+// VPSHUFB only shuffles within each 128-bit half, so the table goes into both.
+// Given a 32-byte __builtin_shuffle, GCC can't tell that the indices stay
+// within their half and shuffles across the whole register instead. Not
+// always_inline, as its target doesn't match the templates it is called from;
+// it only gets inlined into run_avx2().
+__attribute__((target("avx2"))) static inline void shuffle_halves(
+    vectors<BATCH_ENGINE_AVX2_LANES>::lanes* const result,
+    const vectors<BATCH_ENGINE_AVX2_LANES>::table& table,
+    const vectors<BATCH_ENGINE_AVX2_LANES>::lanes& index) {
+    const __m256i halves = _mm256_broadcastsi128_si256((__m128i)table);
+    *result              = (vectors<BATCH_ENGINE_AVX2_LANES>::lanes)
+        _mm256_shuffle_epi8(halves, (__m256i)index);
+}
+#endif  // __x86_64__
+
+// Looks up each lane's entry of `table`: PSHUFB on x86-64, TBL on ARM.
+// Indices are below TABLE_SIZE. Only x86-64 has batches wider than a table.
+template <uint8_t LANE_COUNT>
+BATCH_ENGINE_INLINE void lookup(
+    typename vectors<LANE_COUNT>::lanes* const result,
+    const typename vectors<LANE_COUNT>::table& table,
+    const typename vectors<LANE_COUNT>::lanes& index) {
+    if constexpr (LANE_COUNT == TABLE_SIZE) {
+        *result = __builtin_shuffle(table, index);
+    } else {
+        shuffle_halves(result, table, index);
+    }
+}
+
+// RAM lookup as a tree of selects on the address bits. Shifting an address
+// bit into the sign bit of its lane makes it a blend mask.
+template <uint8_t LANE_COUNT>
+BATCH_ENGINE_INLINE void gather_tree(
+    typename vectors<LANE_COUNT>::lanes* const result,
+    const typename vectors<LANE_COUNT>::lanes table[MEMORY_SIZE],
+    const typename vectors<LANE_COUNT>::lanes& address) {
+    typedef vectors<LANE_COUNT> v;
+
+    typename v::lanes level[MEMORY_SIZE / 2];
+    const typename v::mask set =
+        (typename v::mask)((typename v::words)address << 7) < 0;
+
+#pragma GCC unroll 8
+    for (uint8_t i = 0; i < MEMORY_SIZE / 2; ++i) {
+        level[i] = set ? table[2 * i + 1] : table[2 * i];
+    }
+
+#pragma GCC unroll 3
+    for (uint8_t bit = 1; bit < 4; ++bit) {
+        const typename v::mask set =
+            (typename v::mask)((typename v::words)address << (7 - bit)) < 0;
+
+#pragma GCC unroll 4
+        for (uint8_t i = 0; i < MEMORY_SIZE >> (bit + 1); ++i) {
+            level[i] = set ? level[2 * i + 1] : level[2 * i];
+        }
+    }
+
+    *result = level[0];
+}
+
+// RAM lookup with a different address per lane. Lanes usually run the same
+// code on different data, so most addresses hold the same byte in every lane
+// and a shuffle of the shared copy reads them. The few that vary are blended
+// in on top.
+template <uint8_t LANE_COUNT, bool SHUFFLES>
+BATCH_ENGINE_INLINE void gather(
+    typename vectors<LANE_COUNT>::lanes* const result,
+    const typename vectors<LANE_COUNT>::state* const batch,
+    const typename vectors<LANE_COUNT>::lanes& address) {
+    if (!SHUFFLES ||
+        __builtin_popcount(batch->varying) > MAX_VARYING_ADDRESSES) {
+        gather_tree<LANE_COUNT>(result, batch->ram, address);
+        return;
+    }
+
+    lookup<LANE_COUNT>(result, batch->shared_ram, address);
+    for (uint16_t varying = batch->varying; varying != 0;
+         varying &= varying - 1) {
+        const uint8_t varying_address = __builtin_ctz(varying);
+        *result = address == varying_address ? batch->ram[varying_address]
+                                             : *result;
+    }
+}
+
+// Brings the shared copy of `address` up to date after a store.
+template <uint8_t LANE_COUNT>
+BATCH_ENGINE_INLINE void share(
+    typename vectors<LANE_COUNT>::state* const batch, const uint8_t address) {
+    const typename vectors<LANE_COUNT>::lanes& bytes = batch->ram[address];
+
+    batch->shared_ram[address] = bytes[0];
+    if (any<LANE_COUNT>(bytes != bytes[0])) {
+        batch->varying |= BIT(address);
+    } else {
+        batch->varying &= ~BIT(address);
+    }
+}
+
+// A byte per op code, for decoding with lookup(). Mask tables hold UINT8_MAX
+// for the op codes they match.
+typedef struct {
+    uint8_t entries[OP_CODE_COUNT];
+} op_code_table;
+
+static_assert(OP_CODE_COUNT == TABLE_SIZE, "Op codes must fit a table.");
+
+static constexpr op_code_table op_code_masks(const uint16_t op_codes) {
+    op_code_table table = {};
+    for (uint8_t op_code = 0; op_code < OP_CODE_COUNT; ++op_code) {
+        table.entries[op_code] = (op_codes & BIT(op_code)) != 0 ? UINT8_MAX : 0;
+    }
+
+    return table;
+}
+
+constexpr op_code_table READS_MEMORY =
+    op_code_masks(BIT(LDA) | BIT(ADD) | BIT(SUB) | BIT(ADO));
+constexpr op_code_table LOADS_A = op_code_masks(BIT(LDA) | BIT(LDI));
+constexpr op_code_table IS_ALU  = op_code_masks(BIT(ADD) | BIT(SUB) |
+                                               BIT(ADI) | BIT(SBI) | BIT(ADO));
+constexpr op_code_table SUBTRACTS  = op_code_masks(BIT(SUB) | BIT(SBI));
+constexpr op_code_table WRITES_OUT = op_code_masks(BIT(OUT) | BIT(ADO));
+
+// Every op code jumps on the flags it tests being clear, or set if it isn't
+// in JUMPS_ON_CLEAR. JMP tests none, so it always jumps; the other op codes
+// neither, so they never do.
+static constexpr op_code_table jump_flags(void) {
+    op_code_table table = {};
+    table.entries[JC]   = CARRY;
+    table.entries[JZ]   = ZERO;
+    table.entries[JNC]  = CARRY;
+    table.entries[JNZ]  = ZERO;
+
+    return table;
+}
+
+constexpr op_code_table JUMP_FLAGS = jump_flags();
+constexpr op_code_table JUMPS_ON_CLEAR =
+    op_code_masks(BIT(JMP) | BIT(JNC) | BIT(JNZ));
+
+// Without a shuffle, compares against each op code in the table instead. The
+// tables are constants, so only the op codes with an entry are compared.
+template <uint8_t LANE_COUNT, bool SHUFFLES>
+BATCH_ENGINE_INLINE void decode(
+    typename vectors<LANE_COUNT>::lanes* const result,
+    const op_code_table& table,
+    const typename vectors<LANE_COUNT>::lanes& op_code) {
+    typedef typename vectors<LANE_COUNT>::lanes lanes;
+
+    if constexpr (!SHUFFLES) {
+        *result = (lanes){};
+#pragma GCC unroll 16
+        for (uint8_t entry = 0; entry < OP_CODE_COUNT; ++entry) {
+            if (table.entries[entry] != 0) {
+                *result |= (lanes)(op_code == entry) & table.entries[entry];
+            }
+        }
+        return;
+    }
+
+    typename vectors<LANE_COUNT>::table entries;
+    memcpy(&entries, table.entries, sizeof(entries));
+
+    lookup<LANE_COUNT>(result, entries, op_code);
+}
+
+// Executes one instruction on every lane that hasn't halted, with the same
+// semantics as isa_engine_run().
+template <uint8_t LANE_COUNT, bool SHUFFLES>
+BATCH_ENGINE_INLINE void execute(
+    typename vectors<LANE_COUNT>::state* const batch) {
+    typedef vectors<LANE_COUNT> v;
+    typedef typename v::lanes lanes;
+    typedef typename v::mask mask;
+
+    const mask active = ~batch->halted;
+
+    lanes instruction;
+    gather<LANE_COUNT, SHUFFLES>(&instruction, batch, batch->pc);
+    const lanes arg = instruction & SAP_ADDRESS_MASK;
+
+    lanes operand;
+    gather<LANE_COUNT, SHUFFLES>(&operand, batch, arg);
+
+    // Halted lanes run NOPs, and their PC is held below.
+    const lanes op_code =
+        (lanes)((typename v::words)instruction >> OP_CODE_POS) &
+        MASK(3, 0) & (lanes)active;
+
+    lanes reads_memory, loads_a, is_alu, subtracts, writes_out, jump_flags,
+        jumps_on_clear;
+    decode<LANE_COUNT, SHUFFLES>(&reads_memory, READS_MEMORY, op_code);
+    decode<LANE_COUNT, SHUFFLES>(&loads_a, LOADS_A, op_code);
+    decode<LANE_COUNT, SHUFFLES>(&is_alu, IS_ALU, op_code);
+    decode<LANE_COUNT, SHUFFLES>(&subtracts, SUBTRACTS, op_code);
+    decode<LANE_COUNT, SHUFFLES>(&writes_out, WRITES_OUT, op_code);
+    decode<LANE_COUNT, SHUFFLES>(&jump_flags, JUMP_FLAGS, op_code);
+    decode<LANE_COUNT, SHUFFLES>(&jumps_on_clear, JUMPS_ON_CLEAR, op_code);
+
+    // Subtraction carries when it doesn't borrow.
+    const lanes a         = batch->a;
+    const lanes value     = (mask)reads_memory ? operand : arg;
+    const lanes sum       = a + value;
+    const lanes result    = (mask)subtracts ? a - value : sum;
+    const mask carry      = (mask)subtracts ? a >= value : sum < a;
+    const lanes alu_flags = ((lanes)carry & CARRY) |
+                            ((lanes)(result == 0) & ZERO);
+
+    const lanes flags = batch->flags;
+    const mask jump   = ((flags & jump_flags) == 0) == (mask)jumps_on_clear;
+
+    const mask is_sta = op_code == (uint8_t)STA;
+    if (any<LANE_COUNT>(is_sta)) {
+        for (uint8_t address = 0; address < MEMORY_SIZE; ++address) {
+            const mask store = is_sta & (arg == address);
+            if (any<LANE_COUNT>(store)) {
+                batch->ram[address] = store ? a : batch->ram[address];
+                share<LANE_COUNT>(batch, address);
+            }
+        }
+    }
+
+    batch->out = op_code == (uint8_t)ADO ? result
+                 : (mask)writes_out ? a
+                                    : batch->out;
+    batch->outputs += writes_out & 1;
+
+    const lanes next_pc = (batch->pc + 1) & SAP_ADDRESS_MASK;
+
+    batch->a     = (mask)loads_a ? value : (mask)is_alu ? result : a;
+    batch->b     = (mask)is_alu ? value : batch->b;
+    batch->flags = (mask)is_alu ? alu_flags : flags;
+    batch->pc    = jump ? arg : active ? next_pc : batch->pc;
+
+    batch->executed -= (lanes)active;
+    batch->halted   |= op_code == (uint8_t)HLT;
+}
+
+template <uint8_t LANE_COUNT>
+static void load(typename vectors<LANE_COUNT>::state* const batch,
+                 const sap_machine* const machines, const uint8_t count) {
+    memset(batch, 0, sizeof(*batch));
+    for (uint8_t lane = 0; lane < LANE_COUNT; ++lane) {
+        // Lanes past the last machine halt on a copy of the first one, so
+        // that their RAM doesn't vary.
+        if (lane >= count) {
+            batch->halted[lane] = -1;
+            for (uint8_t address = 0; address < MEMORY_SIZE; ++address) {
+                batch->ram[address][lane] = machines[0].ram[address];
+            }
+            continue;
+        }
+
+        const sap_machine* const machine = &machines[lane];
+        batch->a[lane]      = machine->a;
+        batch->b[lane]      = machine->b;
+        batch->pc[lane]     = machine->pc;
+        batch->flags[lane]  = machine->flags;
+        batch->out[lane]    = machine->out;
+        batch->halted[lane] = machine->halted ? -1 : 0;
+        for (uint8_t address = 0; address < MEMORY_SIZE; ++address) {
+            batch->ram[address][lane] = machine->ram[address];
+        }
+    }
+    batch->halted_before = batch->halted;
+
+    for (uint8_t address = 0; address < MEMORY_SIZE; ++address) {
+        share<LANE_COUNT>(batch, address);
+    }
+}
+
+// Adds the counters to the machines and clears them. Returns the number of
+// instructions executed since the last flush.
+template <uint8_t LANE_COUNT>
+static uint64_t flush(typename vectors<LANE_COUNT>::state* const batch,
+                      sap_machine* const machines, const uint8_t count) {
+    uint64_t executed = 0;
+    for (uint8_t lane = 0; lane < count; ++lane) {
+        sap_machine* const machine  = &machines[lane];
+        const uint8_t lane_executed = batch->executed[lane];
+
+        machine->instructions += lane_executed;
+        machine->cycles       += lane_executed * SAP_CYCLES_PER_INSTRUCTION;
+        machine->outputs      += batch->outputs[lane];
+
+        // HLT stops the clock right after the fetch cycle.
+        if (batch->halted[lane] != 0 && batch->halted_before[lane] == 0) {
+            machine->cycles -= SAP_CYCLES_PER_INSTRUCTION - SAP_HALT_CYCLES;
+        }
+
+        executed += lane_executed;
+    }
+
+    batch->executed      = (typename vectors<LANE_COUNT>::lanes){};
+    batch->outputs       = (typename vectors<LANE_COUNT>::lanes){};
+    batch->halted_before = batch->halted;
+
+    return executed;
+}
+
+template <uint8_t LANE_COUNT>
+static void store(const typename vectors<LANE_COUNT>::state* const batch,
+                  sap_machine* const machines, const uint8_t count) {
+    for (uint8_t lane = 0; lane < count; ++lane) {
+        sap_machine* const machine = &machines[lane];
+        machine->a      = batch->a[lane];
+        machine->b      = batch->b[lane];
+        machine->pc     = batch->pc[lane];
+        machine->flags  = batch->flags[lane];
+        machine->out    = batch->out[lane];
+        machine->halted = batch->halted[lane] != 0;
+        for (uint8_t address = 0; address < MEMORY_SIZE; ++address) {
+            machine->ram[address] = batch->ram[address][lane];
+        }
+    }
+}
+
+template <uint8_t LANE_COUNT, bool SHUFFLES>
+BATCH_ENGINE_INLINE uint64_t run_batch(sap_machine* const machines,
+                                       const uint8_t count,
+                                       const uint64_t max_instructions) {
+    typename vectors<LANE_COUNT>::state batch;
+    load<LANE_COUNT>(&batch, machines, count);
+
+    uint64_t executed  = 0;
+    uint64_t remaining = max_instructions;
+    while (remaining != 0 && any<LANE_COUNT>(~batch.halted)) {
+        const uint8_t steps =
+            remaining < STEPS_PER_FLUSH ? remaining : STEPS_PER_FLUSH;
+        for (uint8_t i = 0; i < steps; ++i) {
+            execute<LANE_COUNT, SHUFFLES>(&batch);
+        }
+
+        executed  += flush<LANE_COUNT>(&batch, machines, count);
+        remaining -= steps;
+    }
+
+    store<LANE_COUNT>(&batch, machines, count);
+
+    return executed;
+}
+
+template <uint8_t LANE_COUNT, bool SHUFFLES>
+BATCH_ENGINE_INLINE uint64_t run_batches(sap_machine* const machines,
+                                         const uint32_t count,
+                                         const uint64_t max_instructions) {
+    uint64_t executed = 0;
+    for (uint32_t first = 0; first < count; first += LANE_COUNT) {
+        const uint32_t left = count - first;
+        executed += run_batch<LANE_COUNT, SHUFFLES>(
+            &machines[first], left < LANE_COUNT ? left : LANE_COUNT,
+            max_instructions);
+    }
+
+    return executed;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2"))) static uint64_t run_avx2(
+    sap_machine* const machines, const uint32_t count,
+    const uint64_t max_instructions) {
+    return run_batches<BATCH_ENGINE_AVX2_LANES, true>(machines, count,
+                                                      max_instructions);
+}
+
+// PSHUFB and PBLENDVB, which the SSE2 baseline lacks.
+__attribute__((target("sse4.1"))) static uint64_t run_sse41(
+    sap_machine* const machines, const uint32_t count,
+    const uint64_t max_instructions) {
+    return run_batches<BATCH_ENGINE_LANES, true>(machines, count,
+                                                 max_instructions);
+}
+#endif  // __x86_64__
+
+// SSE2 on x86-64, NEON on ARM, scalar code elsewhere.
+static uint64_t run_baseline(sap_machine* const machines,
+                             const uint32_t count,
+                             const uint64_t max_instructions) {
+    return run_batches<BATCH_ENGINE_LANES, BASELINE_SHUFFLES>(
+        machines, count, max_instructions);
+}
+
+uint64_t batch_engine_run(sap_machine* const machines, const uint32_t count,
+                          const uint64_t max_instructions) {
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx2")) {
+        return run_avx2(machines, count, max_instructions);
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return run_sse41(machines, count, max_instructions);
+    }
+#endif  // __x86_64__
+
+    return run_baseline(machines, count, max_instructions);
+}
@@ -0,0 +1,103 @@
+#include "fast-forward.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "isa-engine.h"
+#include "program.h"
+#include "sap.h"
+
+// Everything that determines what the machine does next. Compared with
+// memcmp(), so no padding.
+typedef struct {
+    uint8_t a;
+    uint8_t b;
+    uint8_t pc;
+    uint8_t flags;
+    uint8_t out;
+    uint8_t ram[MEMORY_SIZE];
+} machine_state;
+
+typedef struct {
+    machine_state state;
+    uint64_t instructions;
+    uint64_t cycles;
+    uint64_t outputs;
+} snapshot;
+
+static void take_snapshot(snapshot* const snapshot,
+                          const sap_machine* const machine) {
+    snapshot->state.a     = machine->a;
+    snapshot->state.b     = machine->b;
+    snapshot->state.pc    = machine->pc;
+    snapshot->state.flags = machine->flags;
+    snapshot->state.out   = machine->out;
+    memcpy(snapshot->state.ram, machine->ram, MEMORY_SIZE);
+
+    snapshot->instructions = machine->instructions;
+    snapshot->cycles       = machine->cycles;
+    snapshot->outputs      = machine->outputs;
+}
+
+// Brent's algorithm over the states at backward jumps, which every loop goes
+// through, including falling through from the last address to the first. The
+// machine itself is the hare. The tortoise waits at the sample after each
+// power of two, so the period is found within two periods of the loop being
+// entered, without storing more than one state. The state is small enough to
+// be compared in full instead of by hash, so repeats are exact.
+uint64_t fast_forward(sap_machine* const machine,
+                      const uint64_t max_instructions,
+                      fast_forward_period* const period) {
+    *period = {};
+
+    const uint64_t start = machine->instructions;
+    const uint64_t steps = max_instructions < FAST_FORWARD_MAX_STEPS
+                               ? max_instructions
+                               : FAST_FORWARD_MAX_STEPS;
+
+    snapshot tortoise;
+    take_snapshot(&tortoise, machine);
+
+    uint64_t power  = 1;
+    uint64_t length = 0;
+    while (!machine->halted && machine->instructions - start < steps) {
+        const uint8_t pc = machine->pc;
+        (void)isa_engine_run(machine, 1);
+        if (machine->halted || machine->pc > pc) {
+            continue;
+        }
+
+        snapshot hare;
+        take_snapshot(&hare, machine);
+        if (memcmp(&hare.state, &tortoise.state, sizeof(hare.state)) == 0) {
+            period->found        = true;
+            period->detected_at  = machine->instructions;
+            period->instructions = hare.instructions - tortoise.instructions;
+            period->cycles       = hare.cycles - tortoise.cycles;
+            period->outputs      = hare.outputs - tortoise.outputs;
+            break;
+        }
+
+        ++length;
+        if (length == power) {
+            tortoise = hare;
+            power *= 2;
+            length = 0;
+        }
+    }
+
+    if (period->found) {
+        const uint64_t remaining =
+            max_instructions - (machine->instructions - start);
+        const uint64_t periods = remaining / period->instructions;
+
+        machine->instructions += periods * period->instructions;
+        machine->cycles       += periods * period->cycles;
+        machine->outputs      += periods * period->outputs;
+
+        period->periods_skipped = periods;
+    }
+
+    return machine->instructions - start;
+}
@@ -0,0 +1,248 @@
+#include "fuzzer.h"
+
+#include <atomic>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "isa-engine.h"
+#include "microcode-engine.h"
+#include "microcode.h"
+#include "op-code.h"
+#include "program.h"
+#include "sap.h"
+#include "util.h"
+
+// Programs a thread takes at a time. Big enough to keep the shared counter
+// out of the way, small enough to even out programs that halt early.
+constexpr uint64_t CHUNK_SIZE = 256;
+
+constexpr uint64_t NO_DIVERGENCE = UINT64_MAX;
+
+// SplitMix64. (Steele et al., "Fast Splittable Pseudorandom Number
+// Generators")
+static uint64_t mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+
+    return x ^ (x >> 31);
+}
+
+static void generate_image(uint8_t image[MEMORY_SIZE], const uint64_t seed,
+                           const uint64_t index) {
+    const uint64_t stream = mix(seed) ^ index;
+    for (uint8_t i = 0; i < MEMORY_SIZE; i += sizeof(uint64_t)) {
+        const uint64_t bytes = mix(stream * MEMORY_SIZE + i);
+        memcpy(&image[i], &bytes, sizeof(bytes));
+    }
+}
+
+// Cycles the hardware takes for an instruction, worked out from the microcode
+// metadata rather than from the image the engine runs. HLT stops the clock
+// after the fetch cycle. With early ends, everything else stops after its last
+// step that does anything, and a conditional jump that isn't taken after the
+// fetch cycle.
+static uint64_t expected_cycles(const microcode_set set, const uint8_t flags,
+                                const uint8_t op_code) {
+    if (op_code == HLT) {
+        return SAP_HALT_CYCLES;
+    }
+    if (set != MICROCODE_EARLY_END) {
+        return SAP_CYCLES_PER_INSTRUCTION;
+    }
+
+    const microcode_metadata* const metadata = &microcode[op_code];
+    if (metadata->is_conditional &&
+        ((flags & metadata->flags) != 0) == metadata->is_negated) {
+        return ARRAY_SIZE(fetch_cycle);
+    }
+
+    uint64_t cycles = ARRAY_SIZE(fetch_cycle);
+    for (uint8_t step = 0; step < ARRAY_SIZE(metadata->steps); ++step) {
+        if (metadata->steps[step] != 0) {
+            cycles = ARRAY_SIZE(fetch_cycle) + step + 1;
+        }
+    }
+
+    return cycles;
+}
+
+// Cycles are compared separately, as the microcode ends most instructions
+// early.
+static bool same_state(const sap_machine* const x,
+                       const sap_machine* const y) {
+    return x->a == y->a && x->b == y->b && x->pc == y->pc &&
+           x->flags == y->flags && x->out == y->out &&
+           x->halted == y->halted && x->instructions == y->instructions &&
+           x->outputs == y->outputs &&
+           memcmp(x->ram, y->ram, MEMORY_SIZE) == 0;
+}
+
+// Returns the instruction after which the engines first disagree, or 0. The
+// microcode engine also has to take the expected cycles for each instruction.
+static uint64_t find_divergence(const microcode_engine* const engine,
+                                const fuzzer_options* const options,
+                                const uint8_t image[MEMORY_SIZE],
+                                sap_machine* const reference,
+                                sap_machine* const microcoded) {
+    *reference  = {};
+    *microcoded = {};
+    sap_reset(reference, image);
+    sap_reset(microcoded, image);
+
+    for (uint64_t i = 1; i <= options->instruction_count; ++i) {
+        // Both machines are still in the same state here.
+        const uint64_t cycles =
+            microcoded->cycles +
+            expected_cycles(options->set, reference->flags,
+                            reference->ram[reference->pc] >> OP_CODE_POS);
+
+        (void)isa_engine_run(reference, 1);
+        (void)microcode_engine_run(engine, microcoded, 1);
+
+        if (!same_state(reference, microcoded) ||
+            microcoded->cycles != cycles) {
+            return i;
+        }
+        if (reference->halted) {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+static bool diverges(const microcode_engine* const engine,
+                     const fuzzer_options* const options,
+                     const uint8_t image[MEMORY_SIZE]) {
+    sap_machine reference;
+    sap_machine microcoded;
+
+    return find_divergence(engine, options, image, &reference,
+                           &microcoded) != 0;
+}
+
+// Greedily clears whole bytes, then single bits, keeping each change that
+// still diverges. Cleared bytes are NOPs, or zeroes as data.
+static void minimize(const microcode_engine* const engine,
+                     const fuzzer_options* const options,
+                     uint8_t image[MEMORY_SIZE]) {
+    for (uint8_t address = 0; address < MEMORY_SIZE; ++address) {
+        const uint8_t byte = image[address];
+        if (byte == 0) {
+            continue;
+        }
+
+        image[address] = 0;
+        if (!diverges(engine, options, image)) {
+            image[address] = byte;
+        }
+    }
+
+    for (uint8_t address = 0; address < MEMORY_SIZE; ++address) {
+        for (uint8_t bit = 0; bit < 8; ++bit) {
+            const uint8_t byte = image[address];
+            if ((byte & BIT(bit)) == 0) {
+                continue;
+            }
+
+            image[address] = byte & ~BIT(bit);
+            if (!diverges(engine, options, image)) {
+                image[address] = byte;
+            }
+        }
+    }
+}
+
+typedef struct {
+    const microcode_engine* engine;
+    const fuzzer_options* options;
+
+    std::atomic<uint64_t> next_program;
+    std::atomic<uint64_t> first_divergence;
+    std::atomic<uint64_t> programs_run;
+} shared_state;
+
+static void lower_to(std::atomic<uint64_t>* const value,
+                     const uint64_t lower) {
+    uint64_t current = value->load();
+    while (lower < current && !value->compare_exchange_weak(current, lower)) {
+    }
+}
+
+// Threads take chunks off a shared counter until the programs run out or a
+// divergence turns up before their next chunk. Programs after the first
+// divergence found so far are skipped, as they can't be the lowest.
+static void work(shared_state* const shared) {
+    const fuzzer_options* const options = shared->options;
+
+    uint64_t programs_run = 0;
+    for (;;) {
+        const uint64_t start = shared->next_program.fetch_add(CHUNK_SIZE);
+        if (start >= options->program_count ||
+            start >= shared->first_divergence.load()) {
+            break;
+        }
+
+        const uint64_t end = start + CHUNK_SIZE < options->program_count
+                                 ? start + CHUNK_SIZE
+                                 : options->program_count;
+        for (uint64_t index = start; index < end; ++index) {
+            uint8_t image[MEMORY_SIZE];
+            generate_image(image, options->seed, index);
+
+            ++programs_run;
+            if (diverges(shared->engine, options, image)) {
+                lower_to(&shared->first_divergence, index);
+                break;
+            }
+        }
+    }
+
+    shared->programs_run += programs_run;
+}
+
+void fuzzer_run(const microcode_engine* const engine,
+                const fuzzer_options* const options,
+                fuzzer_result* const result) {
+    shared_state shared;
+    shared.engine           = engine;
+    shared.options          = options;
+    shared.next_program     = 0;
+    shared.first_divergence = NO_DIVERGENCE;
+    shared.programs_run     = 0;
+
+    const unsigned int thread_count =
+        options->thread_count > 0 ? options->thread_count : 1;
+
+    // The calling thread is one of the workers.
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < thread_count; ++i) {
+        threads.emplace_back(work, &shared);
+    }
+    work(&shared);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    *result              = {};
+    result->programs_run = shared.programs_run;
+
+    const uint64_t index = shared.first_divergence;
+    if (index == NO_DIVERGENCE) {
+        return;
+    }
+
+    result->found         = true;
+    result->program_index = index;
+    generate_image(result->image, options->seed, index);
+
+    memcpy(result->minimized, result->image, MEMORY_SIZE);
+    minimize(engine, options, result->minimized);
+    result->instruction =
+        find_divergence(engine, options, result->minimized,
+                        &result->reference, &result->microcoded);
+}
@@ -0,0 +1,129 @@
+#include "isa-engine.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "op-code.h"
+#include "sap.h"
+#include "util.h"
+
+uint64_t isa_engine_run(sap_machine* const machine,
+                        const uint64_t max_instructions) {
+    // Work on local copies so that the compiler can keep the registers out of
+    // memory in the dispatch loop.
+    uint8_t a     = machine->a;
+    uint8_t b     = machine->b;
+    uint8_t pc    = machine->pc;
+    uint8_t flags = machine->flags;
+    uint8_t out   = machine->out;
+    bool halted   = machine->halted;
+    uint8_t* const ram = machine->ram;
+
+    uint64_t executed = 0;
+    uint64_t outputs  = 0;
+
+    const auto sync = [&]() {
+        machine->a            = a;
+        machine->b            = b;
+        machine->pc           = pc;
+        machine->flags        = flags;
+        machine->out          = out;
+        machine->halted       = halted;
+        machine->instructions += executed;
+        machine->cycles       += executed * SAP_CYCLES_PER_INSTRUCTION;
+        machine->outputs      += outputs;
+        executed = 0;
+        outputs  = 0;
+    };
+
+    uint64_t remaining = halted ? 0 : max_instructions;
+    uint64_t total     = 0;
+    while (remaining != 0) {
+        const uint8_t instruction = ram[pc];
+        const uint8_t arg         = instruction & SAP_ADDRESS_MASK;
+        pc = (pc + 1) & SAP_ADDRESS_MASK;
+
+        ++executed;
+        --remaining;
+
+        switch (instruction >> OP_CODE_POS) {
+            case LDA:
+                a = ram[arg];
+                break;
+            case ADD:
+                b = ram[arg];
+                a = sap_alu(a, b, false, &flags);
+                break;
+            case SUB:
+                b = ram[arg];
+                a = sap_alu(a, b, true, &flags);
+                break;
+            case STA:
+                ram[arg] = a;
+                break;
+            case LDI:
+                a = arg;
+                break;
+            case ADI:
+                b = arg;
+                a = sap_alu(a, b, false, &flags);
+                break;
+            case SBI:
+                b = arg;
+                a = sap_alu(a, b, true, &flags);
+                break;
+            case JMP:
+                pc = arg;
+                break;
+            case JC:
+                if ((flags & SAP_CARRY) != 0) {
+                    pc = arg;
+                }
+                break;
+            case JZ:
+                if ((flags & SAP_ZERO) != 0) {
+                    pc = arg;
+                }
+                break;
+            case JNC:
+                if ((flags & SAP_CARRY) == 0) {
+                    pc = arg;
+                }
+                break;
+            case JNZ:
+                if ((flags & SAP_ZERO) == 0) {
+                    pc = arg;
+                }
+                break;
+            case ADO:
+                b = ram[arg];
+                a = sap_alu(a, b, false, &flags);
+                [[fallthrough]];
+            case OUT:
+                out = a;
+                ++outputs;
+                if (machine->on_output != nullptr) {
+                    total += executed;
+                    sync();
+                    machine->on_output(machine, machine->context);
+                }
+                break;
+            case HLT:
+                halted    = true;
+                remaining = 0;
+
+                // Accounted for in full by sync().
+                machine->cycles -=
+                    SAP_CYCLES_PER_INSTRUCTION - SAP_HALT_CYCLES;
+                break;
+            default:
+                // NOP has no steps after the fetch cycle.
+                break;
+        }
+    }
+
+    total += executed;
+    sync();
+
+    return total;
+}
@@ -0,0 +1,508 @@
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+
+#include "batch-engine.h"
+#include "fast-forward.h"
+#include "fuzzer.h"
+#include "isa-engine.h"
+#include "microcode-engine.h"
+#include "microcode.h"
+#include "program.h"
+#include "sample-programs.h"
+#include "sap.h"
+#include "threaded-engine.h"
+
+constexpr uint64_t DEFAULT_INSTRUCTION_COUNT   = 1000;
+constexpr uint64_t BENCHMARK_INSTRUCTION_COUNT = 500000000;
+constexpr uint64_t COMPARE_INSTRUCTION_COUNT   = 10000000;
+
+typedef enum {
+    ISA_ENGINE,
+    MICROCODE_ENGINE,
+    THREADED_ENGINE,
+
+    ENGINE_COUNT,
+} engine_type;
+
+static const char* const engine_names[ENGINE_COUNT] = {
+    [ISA_ENGINE]       = "isa",
+    [MICROCODE_ENGINE] = "microcode",
+    [THREADED_ENGINE]  = "threaded",
+};
+
+static const char* const microcode_set_names[MICROCODE_SET_COUNT] = {
+    [MICROCODE_FIXED_LENGTH] = "fixed",
+    [MICROCODE_EARLY_END]    = "early",
+};
+
+typedef struct {
+    engine_type engine;
+    microcode_set set;
+    const char* image_path;
+    uint64_t instruction_count;
+    bool quiet;
+    bool benchmark;
+    bool compare;
+    bool fast_forward;
+    bool sweep;
+    uint64_t fuzz_programs;
+    unsigned int thread_count;
+    uint64_t seed;
+} options;
+
+static void usage(const char* const name) {
+    fprintf(stderr,
+            "Usage: %s [-m engine] [-u set] [-f image] [-n instructions]\n"
+            "          [-q] [-b] [-c] [-s] [-w]\n"
+            "          [-z programs [-j threads] [-r seed]]\n"
+            "\n"
+            "  -m engine        isa (default), microcode or threaded. The\n"
+            "                   microcode engine also reports the cycles\n"
+            "                   saved by ending instructions early.\n"
+            "  -u set           Microcode set: early (default) ends\n"
+            "                   instructions after their last step, fixed\n"
+            "                   runs all of them.\n"
+            "  -f image         Raw %d byte RAM image. Defaults to the\n"
+            "                   bootloader's program.\n"
+            "  -n instructions  Maximum instructions to execute.\n"
+            "  -q               Don't print OUT values.\n"
+            "  -b               Benchmark the engines.\n"
+            "  -c               Compare the cycles per output of sample\n"
+            "                   programs written with and without JNC, JNZ\n"
+            "                   and ADO, on the microcode engine.\n"
+            "  -s               Skip ahead by whole periods once the machine\n"
+            "                   repeats a state, and report the period.\n"
+            "  -w               Sweep the bytes at addresses 14 and 15 over\n"
+            "                   all values with the batch engine, and time\n"
+            "                   it against the isa engine.\n"
+            "  -z programs      Run random RAM images on the isa and\n"
+            "                   microcode engines side by side, for -n\n"
+            "                   instructions each, and report the first\n"
+            "                   divergence.\n"
+            "  -j threads       Defaults to one per core.\n"
+            "  -r seed          Seed of the random images.\n",
+            name, MEMORY_SIZE);
+}
+
+static int parse_options(options* const opts, const int argc,
+                         char* const argv[]) {
+    *opts = {
+        .engine            = ISA_ENGINE,
+        .set               = MICROCODE_EARLY_END,
+        .image_path        = nullptr,
+        .instruction_count = DEFAULT_INSTRUCTION_COUNT,
+        .quiet             = false,
+        .benchmark         = false,
+        .compare           = false,
+        .fast_forward      = false,
+        .sweep             = false,
+        .fuzz_programs     = 0,
+        .thread_count      = std::thread::hardware_concurrency(),
+        .seed              = 1,
+    };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:u:f:n:qbcswz:j:r:")) != -1) {
+        switch (opt) {
+            case 'm':
+                opts->engine = ENGINE_COUNT;
+                for (unsigned short i = 0; i < ENGINE_COUNT; ++i) {
+                    if (strcmp(optarg, engine_names[i]) == 0) {
+                        opts->engine = (engine_type)i;
+                    }
+                }
+                if (opts->engine == ENGINE_COUNT) {
+                    return -1;
+                }
+                break;
+            case 'u':
+                opts->set = MICROCODE_SET_COUNT;
+                for (unsigned short i = 0; i < MICROCODE_SET_COUNT; ++i) {
+                    if (strcmp(optarg, microcode_set_names[i]) == 0) {
+                        opts->set = (microcode_set)i;
+                    }
+                }
+                if (opts->set == MICROCODE_SET_COUNT) {
+                    return -1;
+                }
+                break;
+            case 'f':
+                opts->image_path = optarg;
+                break;
+            case 'n':
+                opts->instruction_count = strtoull(optarg, nullptr, 0);
+                break;
+            case 'q':
+                opts->quiet = true;
+                break;
+            case 'b':
+                opts->benchmark = true;
+                break;
+            case 'c':
+                opts->compare = true;
+                break;
+            case 's':
+                opts->fast_forward = true;
+                break;
+            case 'w':
+                opts->sweep = true;
+                break;
+            case 'z':
+                opts->fuzz_programs = strtoull(optarg, nullptr, 0);
+                break;
+            case 'j':
+                opts->thread_count = strtoul(optarg, nullptr, 0);
+                break;
+            case 'r':
+                opts->seed = strtoull(optarg, nullptr, 0);
+                break;
+            default:
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int load_image(uint8_t image[MEMORY_SIZE], const char* const path) {
+    FILE* const file = fopen(path, "rb");
+    if (file == nullptr) {
+        perror(path);
+        return -1;
+    }
+
+    const size_t size = fread(image, 1, MEMORY_SIZE, file);
+    (void)fclose(file);
+
+    if (size != MEMORY_SIZE) {
+        fprintf(stderr, "%s: expected %d bytes, got %zu\n", path, MEMORY_SIZE,
+                size);
+        return -1;
+    }
+
+    return 0;
+}
+
+static double now(void) {
+    struct timespec ts;
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void print_output(const sap_machine* const machine, void* context) {
+    (void)context;
+    printf("OUT %3u  (cycle %" PRIu64 ")\n", machine->out, machine->cycles);
+}
+
+static void print_report(const sap_machine* const machine) {
+    printf("halted:       %s\n", machine->halted ? "yes" : "no");
+    printf("instructions: %" PRIu64 "\n", machine->instructions);
+    printf("cycles:       %" PRIu64 "\n", machine->cycles);
+    printf("outputs:      %" PRIu64 "\n", machine->outputs);
+    printf("out:          %u\n", machine->out);
+}
+
+// Compares the cycles the microcode took with what they would have been
+// without the step counter reset.
+static void print_cycle_savings(const sap_machine* const machine) {
+    if (machine->cycles == 0) {
+        return;
+    }
+
+    const uint64_t fixed_cycles =
+        machine->instructions * SAP_CYCLES_PER_INSTRUCTION -
+        (machine->halted ? SAP_CYCLES_PER_INSTRUCTION - SAP_HALT_CYCLES : 0);
+
+    printf("fixed length: %" PRIu64 " cycles, %.2fx as many (%.1f%% saved)\n",
+           fixed_cycles, (double)fixed_cycles / machine->cycles,
+           100.0 * (fixed_cycles - machine->cycles) / fixed_cycles);
+}
+
+static void print_period(const fast_forward_period* const period) {
+    if (!period->found) {
+        printf("period:       none found\n");
+        return;
+    }
+
+    printf("period:       %" PRIu64 " instructions, %" PRIu64
+           " cycles, %" PRIu64 " outputs\n",
+           period->instructions, period->cycles, period->outputs);
+    printf("detected at:  instruction %" PRIu64 "\n", period->detected_at);
+    printf("skipped:      %" PRIu64 " periods\n", period->periods_skipped);
+}
+
+static void print_state(const char* const name,
+                        const sap_machine* const machine) {
+    printf("%-10s A %02x  B %02x  PC %2u  flags %u  OUT %02x  halted %u  "
+           "cycles %" PRIu64 "  outputs %" PRIu64 "\n",
+           name, machine->a, machine->b, machine->pc, machine->flags,
+           machine->out, machine->halted, machine->cycles, machine->outputs);
+    printf("%-10s RAM", "");
+    for (unsigned short i = 0; i < MEMORY_SIZE; ++i) {
+        printf(" %02x", machine->ram[i]);
+    }
+    printf("\n");
+}
+
+static int fuzz(const microcode_engine* const microcode,
+                const options* const opts) {
+    const fuzzer_options fuzzer_opts = {
+        .program_count     = opts->fuzz_programs,
+        .instruction_count = opts->instruction_count,
+        .seed              = opts->seed,
+        .thread_count      = opts->thread_count,
+        .set               = opts->set,
+    };
+
+    fuzzer_result result;
+    const double start = now();
+    fuzzer_run(microcode, &fuzzer_opts, &result);
+    const double elapsed = now() - start;
+
+    printf("%" PRIu64 " programs of up to %" PRIu64
+           " instructions on %u threads in %.3f s (%.0f programs/s)\n",
+           result.programs_run, opts->instruction_count, opts->thread_count,
+           elapsed, result.programs_run / elapsed);
+    if (!result.found) {
+        printf("no divergence\n");
+        return 0;
+    }
+
+    printf("program %" PRIu64 " diverges:", result.program_index);
+    for (unsigned short i = 0; i < MEMORY_SIZE; ++i) {
+        printf(" %02x", result.image[i]);
+    }
+    printf("\nminimized:");
+    for (unsigned short i = 0; i < MEMORY_SIZE; ++i) {
+        printf(" %02x", result.minimized[i]);
+    }
+    printf("\nafter instruction %" PRIu64 ":\n", result.instruction);
+    print_state("isa", &result.reference);
+    print_state("microcode", &result.microcoded);
+
+    return -1;
+}
+
+static bool same_result(const sap_machine* const x,
+                        const sap_machine* const y) {
+    return x->a == y->a && x->b == y->b && x->pc == y->pc &&
+           x->flags == y->flags && x->out == y->out &&
+           x->halted == y->halted && x->instructions == y->instructions &&
+           x->cycles == y->cycles && x->outputs == y->outputs &&
+           memcmp(x->ram, y->ram, MEMORY_SIZE) == 0;
+}
+
+// The bootloader's program keeps its data in the last two bytes.
+constexpr uint8_t SWEEP_FIRST_ADDRESS = MEMORY_SIZE - 2;
+constexpr uint32_t SWEEP_SIZE         = 1 << 16;
+
+static void sweep(const uint8_t image[MEMORY_SIZE],
+                  const uint64_t instruction_count) {
+    static sap_machine scalar[SWEEP_SIZE];
+    static sap_machine batched[SWEEP_SIZE];
+    for (uint32_t i = 0; i < SWEEP_SIZE; ++i) {
+        sap_reset(&scalar[i], image);
+        scalar[i].ram[SWEEP_FIRST_ADDRESS]     = i >> 8;
+        scalar[i].ram[SWEEP_FIRST_ADDRESS + 1] = i & MASK(7, 0);
+        batched[i]                             = scalar[i];
+    }
+
+    double start = now();
+    uint64_t executed = 0;
+    for (uint32_t i = 0; i < SWEEP_SIZE; ++i) {
+        executed += isa_engine_run(&scalar[i], instruction_count);
+    }
+    const double scalar_elapsed = now() - start;
+
+    start = now();
+    (void)batch_engine_run(batched, SWEEP_SIZE, instruction_count);
+    const double batch_elapsed = now() - start;
+
+    uint32_t mismatches = 0;
+    for (uint32_t i = 0; i < SWEEP_SIZE; ++i) {
+        mismatches += same_result(&scalar[i], &batched[i]) ? 0 : 1;
+    }
+
+    printf("%u images, %" PRIu64 " instructions\n", SWEEP_SIZE, executed);
+    printf("isa    %.3f s (%.1f MIPS)\n", scalar_elapsed,
+           executed / scalar_elapsed / 1e6);
+    printf("batch  %.3f s (%.1f MIPS, %.2fx isa)\n", batch_elapsed,
+           executed / batch_elapsed / 1e6, scalar_elapsed / batch_elapsed);
+    printf("%u mismatches\n", mismatches);
+}
+
+static int init_microcode(microcode_engine* const engine,
+                          const microcode_set set) {
+    // The same image the microcode programmer writes.
+    const uint8_t* const image = (const uint8_t*)&microcode_eeprom_images[set];
+    if (microcode_engine_init(engine, image) != 0) {
+        fprintf(stderr, "microcode: bus contention at EEPROM address %04x\n",
+                microcode_set_address(set) + engine->conflict_address);
+        return -1;
+    }
+
+    return 0;
+}
+
+static uint64_t run(const engine_type engine,
+                    const microcode_engine* const microcode,
+                    sap_machine* const machine,
+                    const uint64_t instruction_count) {
+    switch (engine) {
+        case ISA_ENGINE:
+            return isa_engine_run(machine, instruction_count);
+        case MICROCODE_ENGINE:
+            return microcode_engine_run(microcode, machine,
+                                        instruction_count);
+        case THREADED_ENGINE:
+            return threaded_engine_run(machine, instruction_count);
+        case ENGINE_COUNT:
+            __builtin_unreachable();
+    }
+
+    return 0;
+}
+
+static void benchmark(const microcode_engine* const microcode,
+                      const uint8_t image[MEMORY_SIZE],
+                      const uint64_t instruction_count) {
+    double isa_rate = 0;
+    for (unsigned short i = 0; i < ENGINE_COUNT; ++i) {
+        // Microsteps are an order of magnitude more expensive.
+        const uint64_t count =
+            i == MICROCODE_ENGINE ? instruction_count / 10 : instruction_count;
+
+        sap_machine machine = {};
+        sap_reset(&machine, image);
+
+        const double start = now();
+        const uint64_t executed =
+            run((engine_type)i, microcode, &machine, count);
+        const double elapsed = now() - start;
+
+        const double rate = executed / elapsed;
+        if (i == ISA_ENGINE) {
+            isa_rate = rate;
+        }
+
+        printf("%-10s %11" PRIu64 " instructions %12" PRIu64
+               " cycles in %.3f s (%.1f MIPS, %.1f M cycles/s, %.2fx isa)\n",
+               engine_names[i], executed, machine.cycles, elapsed, rate / 1e6,
+               machine.cycles / elapsed / 1e6, rate / isa_rate);
+    }
+}
+
+static double run_sample(const microcode_engine* const microcode,
+                         const char* const name, const char* const variant,
+                         const uint8_t* const image,
+                         const uint64_t instruction_count) {
+    sap_machine machine = {};
+    sap_reset(&machine, image);
+    (void)microcode_engine_run(microcode, &machine, instruction_count);
+
+    const double cycles_per_output =
+        machine.outputs != 0 ? (double)machine.cycles / machine.outputs : 0;
+    printf("%-10s %-6s %11" PRIu64 " instructions %12" PRIu64
+           " cycles %10" PRIu64 " outputs (%.2f cycles/output)\n",
+           name, variant, machine.instructions, machine.cycles,
+           machine.outputs, cycles_per_output);
+
+    return cycles_per_output;
+}
+
+// Cycles are what the hardware takes with the current microcode, so the
+// programs are compared per output rather than per instruction.
+static void compare_samples(const microcode_engine* const microcode,
+                            const uint64_t instruction_count) {
+    for (unsigned short i = 0; i < SAMPLE_PROGRAM_COUNT; ++i) {
+        const sample_program* const sample = &sample_programs[i];
+
+        const double before = run_sample(microcode, sample->name, "before",
+                                         sample->before, instruction_count);
+        const double after  = run_sample(microcode, sample->name, "after",
+                                         sample->after, instruction_count);
+        if (after != 0) {
+            printf("%-10s %.2fx fewer cycles per output\n", sample->name,
+                   before / after);
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    options opts;
+    if (parse_options(&opts, argc, argv) != 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    uint8_t image[MEMORY_SIZE];
+    if (opts.image_path == nullptr) {
+        for (unsigned short i = 0; i < MEMORY_SIZE; ++i) {
+            image[i] = program[i];
+        }
+    } else if (load_image(image, opts.image_path) != 0) {
+        return EXIT_FAILURE;
+    }
+
+    static microcode_engine microcode;
+    if (init_microcode(&microcode, opts.set) != 0) {
+        return EXIT_FAILURE;
+    }
+
+    if (opts.fuzz_programs != 0) {
+        return fuzz(&microcode, &opts) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (opts.sweep) {
+        sweep(image, opts.instruction_count);
+        return EXIT_SUCCESS;
+    }
+
+    if (opts.compare) {
+        compare_samples(&microcode,
+                        opts.instruction_count == DEFAULT_INSTRUCTION_COUNT
+                            ? COMPARE_INSTRUCTION_COUNT
+                            : opts.instruction_count);
+        return EXIT_SUCCESS;
+    }
+
+    if (opts.benchmark) {
+        benchmark(&microcode, image,
+                  opts.instruction_count == DEFAULT_INSTRUCTION_COUNT
+                      ? BENCHMARK_INSTRUCTION_COUNT
+                      : opts.instruction_count);
+        return EXIT_SUCCESS;
+    }
+
+    sap_machine machine = {};
+    if (!opts.quiet) {
+        machine.on_output = print_output;
+    }
+    sap_reset(&machine, image);
+
+    if (opts.fast_forward) {
+        fast_forward_period period;
+        const uint64_t executed =
+            fast_forward(&machine, opts.instruction_count, &period);
+        (void)run(opts.engine, &microcode, &machine,
+                  opts.instruction_count - executed);
+        print_report(&machine);
+        print_period(&period);
+        return EXIT_SUCCESS;
+    }
+
+    (void)run(opts.engine, &microcode, &machine, opts.instruction_count);
+    print_report(&machine);
+    if (opts.engine == MICROCODE_ENGINE) {
+        print_cycle_savings(&machine);
+    }
+
+    return EXIT_SUCCESS;
+}
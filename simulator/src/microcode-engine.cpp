@@ -0,0 +1,165 @@
+#include "microcode-engine.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "microcode.h"
+#include "op-code.h"
+#include "sap.h"
+#include "util.h"
+
+// Signals that drive the bus.
+static const uint32_t bus_drivers = CO | RO | IO | AO | EO;
+
+int microcode_engine_init(microcode_engine* const engine,
+                          const uint8_t image[MICROCODE_IMAGE_SIZE]) {
+    for (unsigned short flags = 0; flags < POW2(FLAG_COUNT); ++flags) {
+        for (unsigned short step = 0; step < STEP_COUNT; ++step) {
+            for (unsigned short op_code = 0; op_code < OP_CODE_COUNT;
+                 ++op_code) {
+                const uint16_t lower_address =
+                    microcode_address(flags, LOWER_BYTE, step, op_code);
+                const uint16_t upper_address =
+                    microcode_address(flags, UPPER_BYTE, step, op_code);
+                const uint16_t reset_address =
+                    microcode_address(flags, RESET_BYTE, step, op_code);
+                const uint32_t control_word =
+                    image[lower_address] | image[upper_address] << 8 |
+                    (uint32_t)image[reset_address] << 16;
+
+                if (__builtin_popcount(control_word & bus_drivers) > 1) {
+                    engine->conflict_address = lower_address;
+                    return -1;
+                }
+
+                engine->control_words[flags][step][op_code] = control_word;
+            }
+        }
+    }
+
+    return 0;
+}
+
+uint64_t microcode_engine_run(const microcode_engine* const engine,
+                              sap_machine* const machine,
+                              const uint64_t max_instructions) {
+    uint8_t a     = machine->a;
+    uint8_t b     = machine->b;
+    uint8_t pc    = machine->pc;
+    uint8_t flags = machine->flags;
+    uint8_t out   = machine->out;
+    uint8_t ir    = machine->ir;
+    uint8_t mar   = machine->mar;
+    uint8_t step  = machine->step;
+    bool halted   = machine->halted;
+
+    uint8_t* const ram = machine->ram;
+
+    uint64_t executed = 0;
+    uint64_t cycles   = 0;
+    uint64_t outputs  = 0;
+    uint64_t total    = 0;
+
+    const auto sync = [&]() {
+        machine->a            = a;
+        machine->b            = b;
+        machine->pc           = pc;
+        machine->flags        = flags;
+        machine->out          = out;
+        machine->ir           = ir;
+        machine->mar          = mar;
+        machine->step         = step;
+        machine->halted       = halted;
+        machine->instructions += executed;
+        machine->cycles       += cycles;
+        machine->outputs      += outputs;
+        total    += executed;
+        executed = 0;
+        cycles   = 0;
+        outputs  = 0;
+    };
+
+    while (!halted && total + executed < max_instructions) {
+        const uint32_t control_word =
+            engine->control_words[flags][step][ir >> OP_CODE_POS];
+
+        // Halting stops the clock before the step's rising edge.
+        if ((control_word & HL) != 0) {
+            halted = true;
+            ++executed;
+            break;
+        }
+
+        // The reset clears the step counter before the next rising edge, so
+        // the next instruction's fetch gets the whole cycle.
+        if ((control_word & SR) != 0) {
+            step = 0;
+            ++executed;
+            continue;
+        }
+
+        uint8_t alu_flags;
+        const uint8_t alu =
+            sap_alu(a, b, (control_word & SU) != 0, &alu_flags);
+
+        // microcode_engine_init() guarantees a single bus driver.
+        uint8_t bus = 0;
+        if ((control_word & CO) != 0) {
+            bus = pc;
+        } else if ((control_word & RO) != 0) {
+            bus = ram[mar];
+        } else if ((control_word & IO) != 0) {
+            bus = ir & SAP_ADDRESS_MASK;
+        } else if ((control_word & AO) != 0) {
+            bus = a;
+        } else if ((control_word & EO) != 0) {
+            bus = alu;
+        }
+
+        // Everything below latches on the same rising edge, so it all sees
+        // the register values from before the edge.
+        if ((control_word & RI) != 0) {
+            ram[mar] = bus;
+        }
+        if ((control_word & MI) != 0) {
+            mar = bus & SAP_ADDRESS_MASK;
+        }
+        if ((control_word & II) != 0) {
+            ir = bus;
+        }
+        if ((control_word & AI) != 0) {
+            a = bus;
+        }
+        if ((control_word & BI) != 0) {
+            b = bus;
+        }
+        if ((control_word & CE) != 0) {
+            pc = (pc + 1) & SAP_ADDRESS_MASK;
+        }
+        if ((control_word & J) != 0) {
+            pc = bus & SAP_ADDRESS_MASK;
+        }
+        if ((control_word & FI) != 0) {
+            flags = alu_flags;
+        }
+
+        ++cycles;
+        step = (step + 1) % STEP_COUNT;
+        if (step == 0) {
+            ++executed;
+        }
+
+        if ((control_word & OI) != 0) {
+            out = bus;
+            ++outputs;
+            if (machine->on_output != nullptr) {
+                sync();
+                machine->on_output(machine, machine->context);
+            }
+        }
+    }
+
+    sync();
+
+    return total;
+}
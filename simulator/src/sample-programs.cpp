@@ -0,0 +1,76 @@
+#include "sample-programs.h"
+
+#include <stdint.h>
+
+#include "assembler.h"
+#include "program.h"
+
+// The bootloader's program loops back with a JMP after every value it outputs.
+// Here the loops close with JNC and JNZ instead, and on the way down ADO adds
+// 255, which is SUB 1 with the output folded in.
+static constexpr assembler_result<MEMORY_SIZE> counter =
+    assemble<MEMORY_SIZE>(R"(
+            LDI 1
+    up:     OUT
+    next:   ADD step
+            JNC up
+    down:   ADO minus
+            JNZ down
+            JMP next
+
+            .org 14
+    step:   .byte 1
+    minus:  .byte 255
+)");
+
+// 9 * 7 by repeated addition, outputting the product.
+static constexpr assembler_result<MEMORY_SIZE> multiply =
+    assemble<MEMORY_SIZE>(R"(
+    loop:   LDA total
+            ADD x
+            STA total
+            LDA count
+            SBI 1
+            STA count
+            JZ  done
+            JMP loop
+    done:   LDA total
+            OUT
+            HLT
+
+            .org 13
+    x:      .byte 7
+    count:  .byte 9
+    total:  .byte 0
+)");
+
+static constexpr assembler_result<MEMORY_SIZE> multiply_jnz =
+    assemble<MEMORY_SIZE>(R"(
+    loop:   LDA total
+            ADD x
+            STA total
+            LDA count
+            SBI 1
+            STA count
+            JNZ loop
+            LDA total
+            OUT
+            HLT
+
+            .org 13
+    x:      .byte 7
+    count:  .byte 9
+    total:  .byte 0
+)");
+
+static_assert(assembler_check<counter.error, counter.line>::ok,
+              "Program doesn't assemble.");
+static_assert(assembler_check<multiply.error, multiply.line>::ok,
+              "Program doesn't assemble.");
+static_assert(assembler_check<multiply_jnz.error, multiply_jnz.line>::ok,
+              "Program doesn't assemble.");
+
+const sample_program sample_programs[SAMPLE_PROGRAM_COUNT] = {
+    {"counter",  program,        counter.image     },
+    {"multiply", multiply.image, multiply_jnz.image},
+};
@@ -0,0 +1,17 @@
+#include "sap.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "program.h"
+
+void sap_reset(sap_machine* const machine, const uint8_t image[MEMORY_SIZE]) {
+    const sap_output_handler on_output = machine->on_output;
+    void* const context                = machine->context;
+
+    memset(machine, 0, sizeof(*machine));
+    memcpy(machine->ram, image, MEMORY_SIZE);
+
+    machine->on_output = on_output;
+    machine->context   = context;
+}
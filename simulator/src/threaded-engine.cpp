@@ -0,0 +1,374 @@
+#include "threaded-engine.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "op-code.h"
+#include "program.h"
+#include "sap.h"
+#include "util.h"
+
+typedef enum {
+    // Fused pairs, numbered after the op codes.
+    ADD_JC = OP_CODE_COUNT,
+    ADD_JZ,
+    SUB_JC,
+    SUB_JZ,
+    ADD_OUT,
+    SUB_OUT,
+    OUT_JMP,
+    OUT_JC,
+    OUT_JZ,
+    JC_JMP,
+    JZ_JMP,
+
+    // Falls through from the last address back to the first.
+    WRAP,
+
+    HANDLER_COUNT,
+} superinstruction;
+
+typedef struct threaded_op {
+    const void* handler;
+
+    // Jump target of the instruction, or of the second half of a
+    // superinstruction. Chasing a pointer keeps the op index off the critical
+    // path of taken jumps.
+    const struct threaded_op* target;
+
+    uint8_t arg;
+} threaded_op;
+
+// Falling through past the last address, possibly from the middle of a
+// superinstruction, lands on a WRAP entry so that moving on is always a plain
+// increment.
+#define CODE_SIZE (MEMORY_SIZE + 2)
+
+typedef struct {
+    uint8_t first;
+    uint8_t second;
+    superinstruction fused;
+} fusion;
+
+// Pairs that make up the counting loops typical of SAP programs: an ALU
+// operation feeding a conditional jump or the output, and the output or a
+// conditional jump followed by a jump.
+static const fusion fusions[] = {
+    {ADD, JC,  ADD_JC },
+    {ADD, JZ,  ADD_JZ },
+    {SUB, JC,  SUB_JC },
+    {SUB, JZ,  SUB_JZ },
+    {ADD, OUT, ADD_OUT},
+    {SUB, OUT, SUB_OUT},
+    {OUT, JMP, OUT_JMP},
+    {OUT, JC,  OUT_JC },
+    {OUT, JZ,  OUT_JZ },
+    {JC,  JMP, JC_JMP },
+    {JZ,  JMP, JZ_JMP },
+};
+
+static bool is_jump(const uint8_t op_code) {
+    return op_code == JMP || op_code == JC || op_code == JZ ||
+           op_code == JNC || op_code == JNZ;
+}
+
+// Decode the instruction at `address`, fusing it with its successor where
+// possible.
+static void decode(threaded_op* const code, const uint8_t* const ram,
+                   const void* const* const handlers, const uint8_t address) {
+    const uint8_t next_address = (address + 1) & SAP_ADDRESS_MASK;
+
+    const uint8_t op_code      = ram[address] >> OP_CODE_POS;
+    const uint8_t arg          = ram[address] & SAP_ADDRESS_MASK;
+    const uint8_t next_op_code = ram[next_address] >> OP_CODE_POS;
+    const uint8_t next_arg     = ram[next_address] & SAP_ADDRESS_MASK;
+
+    threaded_op op = {
+        .handler = handlers[op_code],
+        .target  = &code[is_jump(op_code) ? arg : next_arg],
+        .arg     = arg,
+    };
+
+    for (unsigned short i = 0; i < ARRAY_SIZE(fusions); ++i) {
+        if (fusions[i].first == op_code && fusions[i].second == next_op_code) {
+            op.handler = handlers[fusions[i].fused];
+            op.target  = &code[next_arg];
+        }
+    }
+
+    code[address] = op;
+}
+
+// GCC otherwise merges the dispatch sites back into a single indirect jump,
+// which throws away the per-handler branch prediction, and packs the
+// registers into one word on every dispatch for the final store.
+__attribute__((optimize("no-gcse", "no-crossjumping", "no-store-merging",
+                        "no-tree-slp-vectorize"))) uint64_t
+threaded_engine_run(sap_machine* const machine,
+                    const uint64_t max_instructions) {
+    static const void* const handlers[HANDLER_COUNT] = {
+        [NOP] = &&nop, [LDA] = &&lda, [ADD] = &&add, [SUB] = &&sub,
+        [STA] = &&sta, [LDI] = &&ldi, [ADI] = &&adi, [SBI] = &&sbi,
+        [JMP] = &&jmp, [JC] = &&jc,   [JZ] = &&jz,   [OUT] = &&out,
+        [HLT] = &&hlt, [JNC] = &&jnc, [JNZ] = &&jnz, [ADO] = &&ado,
+
+        [ADD_JC] = &&add_jc,   [ADD_JZ] = &&add_jz,   [SUB_JC] = &&sub_jc,
+        [SUB_JZ] = &&sub_jz,   [ADD_OUT] = &&add_out, [SUB_OUT] = &&sub_out,
+        [OUT_JMP] = &&out_jmp, [OUT_JC] = &&out_jc,   [OUT_JZ] = &&out_jz,
+        [JC_JMP] = &&jc_jmp,   [JZ_JMP] = &&jz_jmp,   [WRAP] = &&wrap,
+    };
+
+    if (machine->halted) {
+        return 0;
+    }
+
+    uint8_t a   = machine->a;
+    uint8_t b   = machine->b;
+    uint8_t out = machine->out;
+
+    // Flags are evaluated lazily from the 9-bit result of the last operation
+    // that latched them.
+    uint16_t alu_result = ((machine->flags & SAP_CARRY) != 0 ? BIT(8) : 0) |
+                          ((machine->flags & SAP_ZERO) != 0 ? 0 : 1);
+
+    uint8_t* const ram = machine->ram;
+
+    threaded_op code[CODE_SIZE];
+    for (unsigned short address = 0; address < MEMORY_SIZE; ++address) {
+        decode(code, ram, handlers, address);
+    }
+    for (unsigned short i = MEMORY_SIZE; i < CODE_SIZE; ++i) {
+        code[i].handler = handlers[WRAP];
+    }
+
+    // The instruction about to run. The program counter is only materialized
+    // when the machine state is synced.
+    const threaded_op* op = &code[machine->pc];
+
+    uint64_t remaining = max_instructions;
+    uint64_t synced    = max_instructions;
+    uint64_t outputs   = 0;
+
+#define CARRY (alu_result > MASK(7, 0))
+#define ZERO  ((alu_result & MASK(7, 0)) == 0)
+
+#define SYNC(next)                                                        \
+    do {                                                                  \
+        const uint64_t executed = synced - remaining;                     \
+                                                                          \
+        machine->a     = a;                                               \
+        machine->b     = b;                                               \
+        machine->pc    = ((next) - code) & SAP_ADDRESS_MASK;              \
+        machine->flags = (CARRY ? SAP_CARRY : 0) | (ZERO ? SAP_ZERO : 0); \
+        machine->out   = out;                                             \
+        machine->instructions += executed;                                \
+        machine->cycles += executed * SAP_CYCLES_PER_INSTRUCTION;         \
+        machine->outputs += outputs;                                      \
+        synced  = remaining;                                              \
+        outputs = 0;                                                      \
+    } while (0)
+
+#define DISPATCH()            \
+    do {                      \
+        if (remaining == 0) { \
+            goto done;        \
+        }                     \
+        --remaining;          \
+        goto* op->handler;    \
+    } while (0)
+
+#define NEXT(count)  \
+    do {             \
+        op += count; \
+        DISPATCH();  \
+    } while (0)
+
+#define JUMP(to)    \
+    do {            \
+        op = (to);  \
+        DISPATCH(); \
+    } while (0)
+
+// Superinstructions fall back to their first half when only one instruction
+// of budget is left.
+#define FUSE_OR(single)       \
+    do {                      \
+        if (remaining == 0) { \
+            goto single;      \
+        }                     \
+        --remaining;          \
+    } while (0)
+
+#define ALU(operand, subtract)                      \
+    b          = (operand);                         \
+    alu_result = subtract ? a + BIT(8) - b : a + b; \
+    a          = alu_result & MASK(7, 0)
+
+// `pending` is the number of instructions of a superinstruction that still
+// have to run after the OUT at `offset`, so that the handler sees the same
+// state as with the unfused pair.
+#define OUTPUT(offset, pending)                            \
+    do {                                                   \
+        out = a;                                           \
+        ++outputs;                                         \
+        if (machine->on_output != nullptr) {               \
+            remaining += pending;                          \
+            SYNC(op + (offset) + 1);                       \
+            machine->on_output(machine, machine->context); \
+            remaining -= pending;                          \
+        }                                                  \
+    } while (0)
+
+// Conditional jump as the second half of a superinstruction. Kept as a real
+// branch with its own dispatch; a conditional move would put the flags on the
+// critical path of the next fetch.
+#define BRANCH(condition)     \
+    do {                      \
+        if (condition) {      \
+            JUMP(op->target); \
+        }                     \
+        NEXT(2);              \
+    } while (0)
+
+    DISPATCH();
+
+nop:
+    NEXT(1);
+lda:
+    a = ram[op->arg];
+    NEXT(1);
+add:
+    ALU(ram[op->arg], false);
+    NEXT(1);
+sub:
+    ALU(ram[op->arg], true);
+    NEXT(1);
+sta:
+    ram[op->arg] = a;
+
+    // The written byte may be decoded on its own or as the second half of
+    // its predecessor's superinstruction.
+    decode(code, ram, handlers, op->arg);
+    decode(code, ram, handlers, (op->arg - 1) & SAP_ADDRESS_MASK);
+    NEXT(1);
+ldi:
+    a = op->arg;
+    NEXT(1);
+adi:
+    ALU(op->arg, false);
+    NEXT(1);
+sbi:
+    ALU(op->arg, true);
+    NEXT(1);
+jmp:
+    JUMP(op->target);
+jc:
+    if (CARRY) {
+        JUMP(op->target);
+    }
+    NEXT(1);
+jz:
+    if (ZERO) {
+        JUMP(op->target);
+    }
+    NEXT(1);
+out:
+    OUTPUT(0, 0);
+    NEXT(1);
+hlt:
+    machine->halted = true;
+    machine->cycles -= SAP_CYCLES_PER_INSTRUCTION - SAP_HALT_CYCLES;
+    ++op;
+    goto done;
+jnc:
+    if (!CARRY) {
+        JUMP(op->target);
+    }
+    NEXT(1);
+jnz:
+    if (!ZERO) {
+        JUMP(op->target);
+    }
+    NEXT(1);
+ado:
+    ALU(ram[op->arg], false);
+    OUTPUT(0, 0);
+    NEXT(1);
+
+add_jc:
+    FUSE_OR(add);
+    ALU(ram[op->arg], false);
+    BRANCH(CARRY);
+add_jz:
+    FUSE_OR(add);
+    ALU(ram[op->arg], false);
+    BRANCH(ZERO);
+sub_jc:
+    FUSE_OR(sub);
+    ALU(ram[op->arg], true);
+    BRANCH(CARRY);
+sub_jz:
+    FUSE_OR(sub);
+    ALU(ram[op->arg], true);
+    BRANCH(ZERO);
+add_out:
+    FUSE_OR(add);
+    ALU(ram[op->arg], false);
+    OUTPUT(1, 0);
+    NEXT(2);
+sub_out:
+    FUSE_OR(sub);
+    ALU(ram[op->arg], true);
+    OUTPUT(1, 0);
+    NEXT(2);
+out_jmp:
+    FUSE_OR(out);
+    OUTPUT(0, 1);
+    JUMP(op->target);
+out_jc:
+    FUSE_OR(out);
+    OUTPUT(0, 1);
+    BRANCH(CARRY);
+out_jz:
+    FUSE_OR(out);
+    OUTPUT(0, 1);
+    BRANCH(ZERO);
+jc_jmp:
+    if (CARRY) {
+        // Taken, so the JMP never runs.
+        JUMP(&code[op->arg]);
+    }
+
+    // `target` is the JMP's, so an untaken JC falls back to a NOP rather than
+    // to its own handler.
+    FUSE_OR(nop);
+    JUMP(op->target);
+jz_jmp:
+    if (ZERO) {
+        JUMP(&code[op->arg]);
+    }
+    FUSE_OR(nop);
+    JUMP(op->target);
+
+wrap:
+    // Not an instruction; the budget was already taken by the dispatch.
+    op -= MEMORY_SIZE;
+    goto* op->handler;
+
+#undef BRANCH
+#undef OUTPUT
+#undef ALU
+#undef FUSE_OR
+#undef JUMP
+#undef NEXT
+#undef DISPATCH
+
+done:
+    SYNC(op);
+
+#undef SYNC
+#undef ZERO
+#undef CARRY
+
+    return max_instructions - remaining;
+}